@@ -0,0 +1,401 @@
+#include "blend.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using ::std::min;
+using ::std::vector;
+
+namespace {
+
+// Rows summed into 16-bit channel sums before they could overflow.
+const int MAX_SUMMED_ROWS = 257;
+
+// Exact x / 255 for x in [0, 255 * 255], rounded to nearest.
+inline uint32_t Div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void BlendScalar(uint32_t *dst, const uint32_t *src, int n, uint8_t alpha) {
+    const uint32_t a = alpha, na = 255 - alpha;
+    for (int i = 0; i < n; ++i) {
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t s = (src[i] >> shift) & 0xFF;
+            const uint32_t d = (dst[i] >> shift) & 0xFF;
+            out |= Div255(s * a + d * na) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+void OverScalar(uint32_t *dst, const uint32_t *src, int n) {
+    for (int i = 0; i < n; ++i) {
+        const uint32_t na = 255 - (src[i] >> 24);
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t s = (src[i] >> shift) & 0xFF;
+            const uint32_t d = (dst[i] >> shift) & 0xFF;
+            const uint32_t c = s + Div255(d * na);
+            out |= (c > 255 ? 255 : c) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+void DarkenScalar(uint32_t *dst, int n, uint8_t alpha) {
+    const uint32_t na = 255 - alpha;
+    for (int i = 0; i < n; ++i) {
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            out |= Div255(((dst[i] >> shift) & 0xFF) * na) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+// sums[4 * i + c] = sum of byte c of src[i + r * stride] over rows r.
+void SumRowsScalar(uint16_t *sums, const uint32_t *src, int stride, int rows, int n) {
+    for (int i = 0; i < n; ++i) {
+        uint16_t sum[4] = {0, 0, 0, 0};
+        for (int r = 0; r < rows; ++r) {
+            const uint32_t p = src[static_cast<size_t>(r) * stride + i];
+            for (int c = 0; c < 4; ++c) {
+                sum[c] += (p >> (8 * c)) & 0xFF;
+            }
+        }
+        for (int c = 0; c < 4; ++c) {
+            sums[4 * i + c] = sum[c];
+        }
+    }
+}
+
+// SSE2: four pixels per iteration, two per 16-bit half.
+
+inline __m128i Div255Sse2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+void BlendSse2(uint32_t *dst, const uint32_t *src, int n, uint8_t alpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a = _mm_set1_epi16(alpha);
+    const __m128i na = _mm_set1_epi16(255 - alpha);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        const __m128i lo = Div255Sse2(_mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), a),
+                _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), na)));
+        const __m128i hi = Div255Sse2(_mm_add_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), a),
+                _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), na)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    BlendScalar(dst + i, src + i, n - i, alpha);
+}
+
+inline __m128i InverseAlphaSse2(__m128i s16) {
+    const __m128i sa = _mm_shufflehi_epi16(
+            _mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_sub_epi16(_mm_set1_epi16(255), sa);
+}
+
+void OverSse2(uint32_t *dst, const uint32_t *src, int n) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        const __m128i slo = _mm_unpacklo_epi8(s, zero);
+        const __m128i shi = _mm_unpackhi_epi8(s, zero);
+        const __m128i lo = Div255Sse2(_mm_mullo_epi16(
+                _mm_unpacklo_epi8(d, zero), InverseAlphaSse2(slo)));
+        const __m128i hi = Div255Sse2(_mm_mullo_epi16(
+                _mm_unpackhi_epi8(d, zero), InverseAlphaSse2(shi)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+    OverScalar(dst + i, src + i, n - i);
+}
+
+void DarkenSse2(uint32_t *dst, int n, uint8_t alpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i na = _mm_set1_epi16(255 - alpha);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        const __m128i lo = Div255Sse2(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), na));
+        const __m128i hi = Div255Sse2(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), na));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    DarkenScalar(dst + i, n - i, alpha);
+}
+
+// The sums of a column stack up in registers and are stored once.
+void SumRowsSse2(uint16_t *sums, const uint32_t *src, int stride, int rows, int n) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i lo = zero, hi = zero;
+        for (int r = 0; r < rows; ++r) {
+            const __m128i s = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(src + static_cast<size_t>(r) * stride + i));
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(s, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(s, zero));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + 4 * i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + 4 * i) + 1, hi);
+    }
+    SumRowsScalar(sums + 4 * i, src + i, stride, rows, n - i);
+}
+
+// AVX2: eight pixels per iteration. Unpacking and packing both work per
+// 128-bit lane, so pixel order is preserved.
+
+__attribute__((target("avx2")))
+inline __m256i Div255Avx2(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+void BlendAvx2(uint32_t *dst, const uint32_t *src, int n, uint8_t alpha) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i a = _mm256_set1_epi16(alpha);
+    const __m256i na = _mm256_set1_epi16(255 - alpha);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        const __m256i lo = Div255Avx2(_mm256_add_epi16(
+                _mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), a),
+                _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), na)));
+        const __m256i hi = Div255Avx2(_mm256_add_epi16(
+                _mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), a),
+                _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), na)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    BlendSse2(dst + i, src + i, n - i, alpha);
+}
+
+__attribute__((target("avx2")))
+inline __m256i InverseAlphaAvx2(__m256i s16) {
+    const __m256i sa = _mm256_shufflehi_epi16(
+            _mm256_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_sub_epi16(_mm256_set1_epi16(255), sa);
+}
+
+__attribute__((target("avx2")))
+void OverAvx2(uint32_t *dst, const uint32_t *src, int n) {
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        const __m256i slo = _mm256_unpacklo_epi8(s, zero);
+        const __m256i shi = _mm256_unpackhi_epi8(s, zero);
+        const __m256i lo = Div255Avx2(_mm256_mullo_epi16(
+                _mm256_unpacklo_epi8(d, zero), InverseAlphaAvx2(slo)));
+        const __m256i hi = Div255Avx2(_mm256_mullo_epi16(
+                _mm256_unpackhi_epi8(d, zero), InverseAlphaAvx2(shi)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+    }
+    OverSse2(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void DarkenAvx2(uint32_t *dst, int n, uint8_t alpha) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i na = _mm256_set1_epi16(255 - alpha);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        const __m256i lo = Div255Avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), na));
+        const __m256i hi = Div255Avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), na));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    DarkenSse2(dst + i, n - i, alpha);
+}
+
+__attribute__((target("avx2")))
+void SumRowsAvx2(uint16_t *sums, const uint32_t *src, int stride, int rows, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+        for (int r = 0; r < rows; ++r) {
+            const uint32_t *row = src + static_cast<size_t>(r) * stride + i;
+            // Widening whole 128-bit halves keeps the pixels in order.
+            lo = _mm256_add_epi16(lo, _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(row))));
+            hi = _mm256_add_epi16(hi, _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 4))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + 4 * i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + 4 * i) + 1, hi);
+    }
+    SumRowsSse2(sums + 4 * i, src + i, stride, rows, n - i);
+}
+
+struct Kernels {
+    void (*blend)(uint32_t *, const uint32_t *, int, uint8_t);
+    void (*over)(uint32_t *, const uint32_t *, int);
+    void (*darken)(uint32_t *, int, uint8_t);
+    void (*sum_rows)(uint16_t *, const uint32_t *, int, int, int);
+    const char *name;
+};
+
+Kernels SelectKernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Kernels{BlendAvx2, OverAvx2, DarkenAvx2, SumRowsAvx2, "avx2"};
+    }
+    return Kernels{BlendSse2, OverSse2, DarkenSse2, SumRowsSse2, "sse2"};
+}
+
+const Kernels KERNELS = SelectKernels();
+
+// Picks up to max_taps source positions in each of the n boxes a source
+// extent of size is divided into, at the centres of equal parts of the box.
+// Box i gets counts[i] taps, stored from taps[i * max_taps].
+void SampleTaps(int size, int n, int max_taps, vector<int> *taps, vector<int> *counts) {
+    taps->resize(static_cast<size_t>(n) * max_taps);
+    counts->resize(n);
+    for (int i = 0; i < n; ++i) {
+        const int begin = static_cast<int>(static_cast<int64_t>(i) * size / n);
+        const int length = static_cast<int>(static_cast<int64_t>(i + 1) * size / n) - begin;
+        const int count = min(length, max_taps);
+        for (int k = 0; k < count; ++k) {
+            (*taps)[static_cast<size_t>(i) * max_taps + k] = begin + (2 * k + 1) * length / (2 * count);
+        }
+        (*counts)[i] = count;
+    }
+}
+
+}
+
+void BlendSpan(uint32_t *dst, const uint32_t *src, int n, uint8_t alpha) {
+    KERNELS.blend(dst, src, n, alpha);
+}
+
+void OverSpan(uint32_t *dst, const uint32_t *src, int n) {
+    KERNELS.over(dst, src, n);
+}
+
+void DarkenSpan(uint32_t *dst, int n, uint8_t alpha) {
+    KERNELS.darken(dst, n, alpha);
+}
+
+void DownscaleBox(const uint32_t *src, int src_stride, int src_width, int src_height,
+                  uint32_t *dst, int dst_stride, int dst_width, int dst_height) {
+    if (dst_width <= 0 || dst_height <= 0 || dst_width > src_width || dst_height > src_height) {
+        return;
+    }
+    // Source columns [left[x], left[x + 1]) make up destination column x.
+    vector<int> left(dst_width + 1);
+    for (int x = 0; x <= dst_width; ++x) {
+        left[x] = static_cast<int>(static_cast<int64_t>(x) * src_width / dst_width);
+    }
+    // Each destination row first sums its source rows per column with the
+    // SIMD kernel, then the columns of each destination pixel.
+    vector<uint16_t> columns(4 * static_cast<size_t>(src_width));
+    vector<uint32_t> sums(4 * static_cast<size_t>(dst_width));
+    for (int y = 0; y < dst_height; ++y) {
+        const int top = static_cast<int>(static_cast<int64_t>(y) * src_height / dst_height);
+        const int bottom = static_cast<int>(static_cast<int64_t>(y + 1) * src_height / dst_height);
+        ::std::fill(sums.begin(), sums.end(), 0);
+        for (int row = top; row < bottom; row += MAX_SUMMED_ROWS) {
+            KERNELS.sum_rows(columns.data(), src + static_cast<size_t>(row) * src_stride,
+                             src_stride, min(bottom - row, MAX_SUMMED_ROWS), src_width);
+            // Every CPU the kernels run on has SSE2.
+            const __m128i zero = _mm_setzero_si128();
+            for (int x = 0; x < dst_width; ++x) {
+                __m128i *out = reinterpret_cast<__m128i *>(&sums[4 * x]);
+                __m128i sum = _mm_loadu_si128(out);
+                int col = left[x];
+                for (; col + 2 <= left[x + 1]; col += 2) {
+                    const __m128i two = _mm_loadu_si128(
+                            reinterpret_cast<const __m128i *>(&columns[4 * col]));
+                    sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(two, zero),
+                                                           _mm_unpackhi_epi16(two, zero)));
+                }
+                if (col < left[x + 1]) {
+                    const __m128i one = _mm_loadl_epi64(
+                            reinterpret_cast<const __m128i *>(&columns[4 * col]));
+                    sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(one, zero));
+                }
+                _mm_storeu_si128(out, sum);
+            }
+        }
+        uint32_t *out = dst + static_cast<size_t>(y) * dst_stride;
+        for (int x = 0; x < dst_width; ++x) {
+            const uint64_t area = static_cast<uint64_t>(bottom - top) * (left[x + 1] - left[x]);
+            // (n * reciprocal) >> 40 is exactly n / area as long as
+            // n * area <= 2^40, which holds for boxes of up to 2^16 pixels.
+            const uint64_t reciprocal = (uint64_t(1) << 40) / area + 1;
+            uint32_t pixel = 0;
+            for (int c = 0; c < 4; ++c) {
+                const uint64_t n = sums[4 * x + c] + area / 2;
+                const uint64_t average = area <= 65536 ? (n * reciprocal) >> 40 : n / area;
+                pixel |= static_cast<uint32_t>(average) << (8 * c);
+            }
+            out[x] = pixel;
+        }
+    }
+}
+
+void DownscaleSampled(const uint32_t *src, int src_stride, int src_width, int src_height,
+                      uint32_t *dst, int dst_stride, int dst_width, int dst_height,
+                      int max_taps) {
+    if (dst_width <= 0 || dst_height <= 0 || dst_width > src_width || dst_height > src_height) {
+        return;
+    }
+    // Every source pixel is a tap: the row kernels of the box filter are faster.
+    if ((src_width + dst_width - 1) / dst_width <= max_taps &&
+        (src_height + dst_height - 1) / dst_height <= max_taps) {
+        DownscaleBox(src, src_stride, src_width, src_height, dst, dst_stride, dst_width, dst_height);
+        return;
+    }
+    vector<int> columns, column_counts, rows, row_counts;
+    SampleTaps(src_width, dst_width, max_taps, &columns, &column_counts);
+    SampleTaps(src_height, dst_height, max_taps, &rows, &row_counts);
+    // Up to 16 x 16 taps of at most 255 fit the 16-bit channel sums.
+    const __m128i zero = _mm_setzero_si128();
+    vector<__m128i> sums(dst_width);
+    for (int y = 0; y < dst_height; ++y) {
+        ::std::fill(sums.begin(), sums.end(), zero);
+        for (int k = 0; k < row_counts[y]; ++k) {
+            const uint32_t *row = src + static_cast<size_t>(rows[static_cast<size_t>(y) * max_taps + k]) * src_stride;
+            const int *tap = columns.data();
+            for (int x = 0; x < dst_width; ++x, tap += max_taps) {
+                __m128i sum = sums[x];
+                for (int j = 0; j < column_counts[x]; ++j) {
+                    sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(_mm_cvtsi32_si128(row[tap[j]]), zero));
+                }
+                sums[x] = sum;
+            }
+        }
+        uint32_t *out = dst + static_cast<size_t>(y) * dst_stride;
+        for (int x = 0; x < dst_width; ++x) {
+            const uint32_t area = row_counts[y] * column_counts[x];
+            // Exact division for sums of up to 2^16, as in DownscaleBox.
+            const uint64_t reciprocal = (uint64_t(1) << 40) / area + 1;
+            alignas(16) uint16_t channels[8];
+            _mm_store_si128(reinterpret_cast<__m128i *>(channels), sums[x]);
+            uint32_t pixel = 0;
+            for (int c = 0; c < 4; ++c) {
+                const uint64_t average = ((channels[c] + area / 2) * reciprocal) >> 40;
+                pixel |= static_cast<uint32_t>(average) << (8 * c);
+            }
+            out[x] = pixel;
+        }
+    }
+}
+
+const char *BlendImplementation() {
+    return KERNELS.name;
+}
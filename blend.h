@@ -0,0 +1,38 @@
+#ifndef SIMPLEWM_BLEND_H
+#define SIMPLEWM_BLEND_H
+
+#include <cstdint>
+
+// Software pixel kernels over spans of 32-bit pixels in x8r8g8b8 or
+// premultiplied a8r8g8b8 layout.
+//
+// The implementation is picked once at startup: AVX2 if the CPU supports it,
+// SSE2 otherwise. All variants produce bit-identical results.
+
+// dst = src * alpha + dst * (1 - alpha), for opaque src.
+void BlendSpan(uint32_t *dst, const uint32_t *src, int n, uint8_t alpha);
+
+// dst = src + dst * (1 - src.alpha), for premultiplied src.
+void OverSpan(uint32_t *dst, const uint32_t *src, int n);
+
+// dst = dst * (1 - alpha). Used to draw shadows.
+void DarkenSpan(uint32_t *dst, int n, uint8_t alpha);
+
+// Scales a src_width x src_height image down to dst_width x dst_height,
+// which must not be larger, with a box filter: each destination pixel is
+// the average of the source pixels it covers. Strides are in pixels.
+void DownscaleBox(const uint32_t *src, int src_stride, int src_width, int src_height,
+                  uint32_t *dst, int dst_stride, int dst_width, int dst_height);
+
+// Like DownscaleBox, but averages at most max_taps x max_taps source pixels
+// spread evenly over each box, so the cost no longer grows with the scale
+// factor. Identical to DownscaleBox where boxes are no larger than that.
+// max_taps must be at most 16.
+void DownscaleSampled(const uint32_t *src, int src_stride, int src_width, int src_height,
+                      uint32_t *dst, int dst_stride, int dst_width, int dst_height,
+                      int max_taps);
+
+// Returns the name of the kernel implementation in use.
+const char *BlendImplementation();
+
+#endif
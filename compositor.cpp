@@ -0,0 +1,640 @@
+#include "compositor.h"
+extern "C" {
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/shape.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+}
+#include <algorithm>
+#include <cstring>
+#include <glog/logging.h>
+#include "blend.h"
+
+using ::std::max;
+using ::std::min;
+using ::std::unique_ptr;
+using ::std::vector;
+
+namespace {
+
+uint32_t *Row(XImage *image, int x, int y) {
+    return reinterpret_cast<uint32_t *>(image->data + y * image->bytes_per_line) + x;
+}
+
+}
+
+Compositor::Compositor(Display *display, Window root)
+    : display_(display),
+      root_(root),
+      overlay_(None),
+      gc_(None),
+      damage_event_base_(0),
+      shm_completion_type_(0),
+      put_pending_(false),
+      wallpaper_pixmap_(None),
+      overview_(false),
+      overview_presented_(false) {
+}
+
+Compositor::~Compositor() {
+    for (auto &s : stack_) {
+        UnmapSurface(s.get());
+    }
+    DestroyShmImage(&back_);
+    if (gc_ != None) {
+        XFreeGC(display_, gc_);
+    }
+    if (overlay_ != None) {
+        XCompositeReleaseOverlayWindow(display_, root_);
+        XCompositeUnredirectSubwindows(display_, root_, CompositeRedirectManual);
+    }
+}
+
+bool Compositor::Init(Pixmap wallpaper) {
+    int event_base, error_base, major = 0, minor = 4;
+    if (!XCompositeQueryExtension(display_, &event_base, &error_base) ||
+        !XCompositeQueryVersion(display_, &major, &minor) ||
+        (major == 0 && minor < 3)) {
+        LOG(ERROR) << "Compositing needs Composite 0.3";
+        return false;
+    }
+    if (!XDamageQueryExtension(display_, &damage_event_base_, &error_base)) {
+        LOG(ERROR) << "Compositing needs the Damage extension";
+        return false;
+    }
+    if (!XFixesQueryExtension(display_, &event_base, &error_base)) {
+        LOG(ERROR) << "Compositing needs the XFixes extension";
+        return false;
+    }
+    if (!XShmQueryExtension(display_)) {
+        LOG(ERROR) << "Compositing needs the MIT-SHM extension";
+        return false;
+    }
+    shm_completion_type_ = XShmGetEventBase(display_) + ShmCompletion;
+
+    const int screen = DefaultScreen(display_);
+    screen_.x = 0;
+    screen_.y = 0;
+    screen_.width = DisplayWidth(display_, screen);
+    screen_.height = DisplayHeight(display_, screen);
+    if (!CreateShmImage(DefaultVisual(display_, screen), DefaultDepth(display_, screen),
+                        screen_.width, screen_.height, &back_)) {
+        return false;
+    }
+    if (back_.image->bits_per_pixel != 32) {
+        LOG(ERROR) << "Compositing needs a 32 bits per pixel visual";
+        DestroyShmImage(&back_);
+        return false;
+    }
+
+    XCompositeRedirectSubwindows(display_, root_, CompositeRedirectManual);
+    overlay_ = XCompositeGetOverlayWindow(display_, root_);
+    // The overlay must not swallow input meant for the windows below it.
+    XserverRegion empty = XFixesCreateRegion(display_, nullptr, 0);
+    XFixesSetWindowShapeRegion(display_, overlay_, ShapeInput, 0, 0, empty);
+    XFixesDestroyRegion(display_, empty);
+    XSelectInput(display_, overlay_, ExposureMask);
+    gc_ = XCreateGC(display_, overlay_, 0, nullptr);
+
+    SetWallpaper(wallpaper);
+
+    Window returned_root, returned_parent;
+    Window *children;
+    unsigned int num_children;
+    if (XQueryTree(display_, root_, &returned_root, &returned_parent,
+                   &children, &num_children)) {
+        for (unsigned int i = 0; i < num_children; ++i) {
+            AddSurface(children[i]);
+        }
+        XFree(children);
+    }
+
+    LOG(INFO) << "Compositing with " << BlendImplementation() << " kernels";
+    DamageAll();
+    return true;
+}
+
+bool Compositor::HandleEvent(const XEvent &e) {
+    if (e.type == damage_event_base_ + XDamageNotify) {
+        const XDamageNotifyEvent &de = reinterpret_cast<const XDamageNotifyEvent &>(e);
+        auto it = FindSurface(de.drawable);
+        if (it == stack_.end()) {
+            return true;
+        }
+        Surface *s = it->get();
+        s->stale = true;
+        s->thumbnail_stale = true;
+        if (overview_) {
+            // Only the thumbnail is on the screen, so the damaged parts of
+            // the window do not matter.
+            XDamageSubtract(display_, s->damage, None, None);
+            if (!s->overview_rect.empty()) {
+                AddDamage(s->overview_rect);
+            }
+            return true;
+        }
+        // The event carries the bounding box of the damage, so there is no
+        // region to fetch. Clearing the damage makes the next change report
+        // again; changes within the box before then are covered by it.
+        XDamageSubtract(display_, s->damage, None, None);
+        AddDamage(Box{de.area.x, de.area.y, de.area.width, de.area.height}
+                          .Translate(s->rect.x + s->border, s->rect.y + s->border));
+        return true;
+    }
+    if (e.type == shm_completion_type_) {
+        put_pending_ = false;
+        return true;
+    }
+
+    switch (e.type) {
+        case CreateNotify:
+            if (e.xcreatewindow.parent == root_) {
+                AddSurface(e.xcreatewindow.window);
+            }
+            break;
+        case DestroyNotify:
+            if (e.xdestroywindow.event == root_) {
+                RemoveSurface(e.xdestroywindow.window);
+            }
+            break;
+        case ReparentNotify:
+            if (e.xreparent.event != root_) {
+                break;
+            }
+            if (e.xreparent.parent == root_) {
+                AddSurface(e.xreparent.window);
+            } else {
+                RemoveSurface(e.xreparent.window);
+            }
+            break;
+        case MapNotify:
+            if (e.xmap.event == root_) {
+                auto it = FindSurface(e.xmap.window);
+                if (it != stack_.end()) {
+                    MapSurface(it->get());
+                }
+            }
+            break;
+        case UnmapNotify:
+            if (e.xunmap.event == root_) {
+                auto it = FindSurface(e.xunmap.window);
+                if (it != stack_.end()) {
+                    UnmapSurface(it->get());
+                }
+            }
+            break;
+        case ConfigureNotify: {
+            if (e.xconfigure.event != root_) {
+                break;
+            }
+            auto it = FindSurface(e.xconfigure.window);
+            if (it == stack_.end()) {
+                break;
+            }
+            Surface *s = it->get();
+            if (s->mapped) {
+                AddDamage(Extent(*s));
+            }
+            const bool resized = s->rect.width != e.xconfigure.width + 2 * e.xconfigure.border_width ||
+                                 s->rect.height != e.xconfigure.height + 2 * e.xconfigure.border_width;
+            s->rect.x = e.xconfigure.x;
+            s->rect.y = e.xconfigure.y;
+            s->rect.width = e.xconfigure.width + 2 * e.xconfigure.border_width;
+            s->rect.height = e.xconfigure.height + 2 * e.xconfigure.border_width;
+            s->border = e.xconfigure.border_width;
+            if (resized && s->mapped) {
+                UnmapSurface(s);
+                MapSurface(s);
+            }
+            Restack(e.xconfigure.window, e.xconfigure.above);
+            if (s->mapped) {
+                AddDamage(Extent(*s));
+            }
+            break;
+        }
+        case CirculateNotify:
+            if (e.xcirculate.event == root_) {
+                auto it = FindSurface(e.xcirculate.window);
+                if (it != stack_.end()) {
+                    unique_ptr<Surface> s = ::std::move(*it);
+                    stack_.erase(it);
+                    AddDamage(Extent(*s));
+                    if (e.xcirculate.place == PlaceOnTop) {
+                        stack_.push_back(::std::move(s));
+                    } else {
+                        stack_.insert(stack_.begin(), ::std::move(s));
+                    }
+                }
+            }
+            break;
+        case Expose:
+            if (e.xexpose.window == overlay_) {
+                AddDamage(Box{e.xexpose.x, e.xexpose.y, e.xexpose.width, e.xexpose.height});
+                return true;
+            }
+            break;
+    }
+    return false;
+}
+
+void Compositor::Decorate(Window frame, uint8_t opacity, bool shadow) {
+    decorations_[frame] = ::std::make_pair(opacity, shadow);
+    auto it = FindSurface(frame);
+    if (it != stack_.end()) {
+        (*it)->opacity = opacity;
+        (*it)->shadow = shadow;
+        if ((*it)->mapped) {
+            AddDamage(Extent(**it));
+        }
+    }
+}
+
+void Compositor::SetWallpaper(Pixmap wallpaper) {
+    wallpaper_pixmap_ = wallpaper;
+    wallpaper_.assign(static_cast<size_t>(screen_.width) * screen_.height, 0);
+    if (wallpaper != None) {
+        Window returned_root;
+        int x, y;
+        unsigned int width, height, border, depth;
+        XImage *image = nullptr;
+        if (XGetGeometry(display_, wallpaper, &returned_root, &x, &y,
+                         &width, &height, &border, &depth)) {
+            image = XGetImage(display_, wallpaper, 0, 0, width, height, AllPlanes, ZPixmap);
+        }
+        if (image != nullptr) {
+            // The root background tiles from the origin.
+            for (int row = 0; row < screen_.height; ++row) {
+                uint32_t *out = &wallpaper_[static_cast<size_t>(row) * screen_.width];
+                for (int col = 0; col < screen_.width; ++col) {
+                    out[col] = XGetPixel(image, col % width, row % height);
+                }
+            }
+            XDestroyImage(image);
+        }
+    }
+    DamageAll();
+}
+
+void Compositor::Resize() {
+    const int screen = DefaultScreen(display_);
+    if (screen_.width == DisplayWidth(display_, screen) &&
+        screen_.height == DisplayHeight(display_, screen)) {
+        return;
+    }
+    screen_.width = DisplayWidth(display_, screen);
+    screen_.height = DisplayHeight(display_, screen);
+    DestroyShmImage(&back_);
+    if (!CreateShmImage(DefaultVisual(display_, screen), DefaultDepth(display_, screen),
+                        screen_.width, screen_.height, &back_)) {
+        LOG(FATAL) << "Failed to reallocate the compositing back buffer";
+    }
+    put_pending_ = false;
+    SetWallpaper(wallpaper_pixmap_);
+}
+
+void Compositor::ShowOverview(const vector<::std::pair<Window, Box>> &thumbnails) {
+    for (auto &s : stack_) {
+        s->overview_rect = Box{0, 0, 0, 0};
+    }
+    for (const auto &t : thumbnails) {
+        auto it = FindSurface(t.first);
+        if (it == stack_.end()) {
+            continue;
+        }
+        Surface *s = it->get();
+        // Thumbnails are only ever scaled down.
+        s->overview_rect = Box{t.second.x, t.second.y, min(t.second.width, s->rect.width),
+                               min(t.second.height, s->rect.height)};
+    }
+    if (!overview_) {
+        overview_shown_ = ::std::chrono::steady_clock::now();
+        overview_presented_ = false;
+    }
+    overview_ = true;
+    if (!workers_) {
+        workers_.reset(new WorkerPool());
+        LOG(INFO) << "Scaling thumbnails with " << workers_->size() + 1 << " threads";
+    }
+    DamageAll();
+}
+
+void Compositor::HideOverview() {
+    if (!overview_) {
+        return;
+    }
+    overview_ = false;
+    for (auto &s : stack_) {
+        s->overview_rect = Box{0, 0, 0, 0};
+    }
+    DamageAll();
+}
+
+void Compositor::Paint() {
+    if (put_pending_ || damage_.empty()) {
+        return;
+    }
+
+    if (overview_) {
+        UpdateThumbnails();
+    } else {
+        for (auto &s : stack_) {
+            if (!s->mapped || !s->stale) {
+                continue;
+            }
+            if (damage_.Intersects(Extent(*s))) {
+                Fetch(s.get());
+            }
+        }
+    }
+
+    // The rectangles of a region do not overlap, so no pixel is composited
+    // twice.
+    damage_.Intersect(screen_);
+    for (const Box &r : damage_) {
+        if (overview_) {
+            CompositeOverview(r);
+        } else {
+            Composite(r);
+        }
+        // Only the last request asks for a completion event; requests are
+        // processed in order, so it covers the whole frame.
+        XShmPutImage(display_, overlay_, gc_, back_.image,
+                     r.x, r.y, r.x, r.y, r.width, r.height, &r + 1 == damage_.end());
+    }
+    put_pending_ = !damage_.empty();
+    damage_.Clear();
+
+    if (overview_ && !overview_presented_) {
+        overview_presented_ = true;
+        LOG(INFO) << "Composited the overview in "
+                  << ::std::chrono::duration_cast<::std::chrono::milliseconds>(
+                             ::std::chrono::steady_clock::now() - overview_shown_).count()
+                  << " ms";
+    }
+}
+
+bool Compositor::CreateShmImage(Visual *visual, int depth, int width, int height, ShmImage *out) {
+    out->image = XShmCreateImage(display_, visual, depth, ZPixmap, nullptr,
+                                 &out->info, max(width, 1), max(height, 1));
+    if (out->image == nullptr) {
+        LOG(ERROR) << "XShmCreateImage failed";
+        return false;
+    }
+    out->info.shmid = shmget(IPC_PRIVATE, out->image->bytes_per_line * out->image->height,
+                             IPC_CREAT | 0600);
+    if (out->info.shmid < 0) {
+        PLOG(ERROR) << "shmget failed";
+        XDestroyImage(out->image);
+        out->image = nullptr;
+        return false;
+    }
+    out->info.shmaddr = out->image->data = static_cast<char *>(shmat(out->info.shmid, nullptr, 0));
+    out->info.readOnly = false;
+    XShmAttach(display_, &out->info);
+    XSync(display_, false);
+    // The segment is freed once both sides have detached.
+    shmctl(out->info.shmid, IPC_RMID, nullptr);
+    return true;
+}
+
+void Compositor::DestroyShmImage(ShmImage *image) {
+    if (image->image == nullptr) {
+        return;
+    }
+    XShmDetach(display_, &image->info);
+    image->image->data = nullptr;
+    XDestroyImage(image->image);
+    shmdt(image->info.shmaddr);
+    image->image = nullptr;
+}
+
+void Compositor::AddSurface(Window w) {
+    if (w == overlay_ || FindSurface(w) != stack_.end()) {
+        return;
+    }
+    XWindowAttributes attrs;
+    if (!XGetWindowAttributes(display_, w, &attrs) || attrs.c_class == InputOnly) {
+        return;
+    }
+    unique_ptr<Surface> s(new Surface);
+    s->window = w;
+    s->rect.x = attrs.x;
+    s->rect.y = attrs.y;
+    s->rect.width = attrs.width + 2 * attrs.border_width;
+    s->rect.height = attrs.height + 2 * attrs.border_width;
+    s->border = attrs.border_width;
+    s->visual = attrs.visual;
+    s->depth = attrs.depth;
+    s->argb = attrs.depth == 32;
+    s->mapped = false;
+    s->stale = true;
+    s->opacity = 255;
+    s->shadow = false;
+    s->damage = None;
+    s->pixmap = None;
+    s->overview_rect = Box{0, 0, 0, 0};
+    s->thumbnail_width = 0;
+    s->thumbnail_height = 0;
+    s->thumbnail_stale = true;
+    auto decoration = decorations_.find(w);
+    if (decoration != decorations_.end()) {
+        s->opacity = decoration->second.first;
+        s->shadow = decoration->second.second;
+    }
+    Surface *raw = s.get();
+    stack_.push_back(::std::move(s));
+    if (attrs.map_state == IsViewable) {
+        MapSurface(raw);
+    }
+}
+
+void Compositor::RemoveSurface(Window w) {
+    auto it = FindSurface(w);
+    if (it == stack_.end()) {
+        return;
+    }
+    UnmapSurface(it->get());
+    stack_.erase(it);
+    decorations_.erase(w);
+}
+
+vector<unique_ptr<Compositor::Surface>>::iterator Compositor::FindSurface(Window w) {
+    return ::std::find_if(stack_.begin(), stack_.end(),
+                          [w](const unique_ptr<Surface> &s) { return s->window == w; });
+}
+
+void Compositor::MapSurface(Surface *s) {
+    if (s->mapped) {
+        return;
+    }
+    s->mapped = true;
+    s->stale = true;
+    s->thumbnail_stale = true;
+    s->pixmap = XCompositeNameWindowPixmap(display_, s->window);
+    s->damage = XDamageCreate(display_, s->window, XDamageReportBoundingBox);
+    if (!CreateShmImage(s->visual, s->depth, s->rect.width, s->rect.height, &s->shm)) {
+        LOG(ERROR) << "Cannot composite window " << s->window;
+    }
+    AddDamage(Extent(*s));
+}
+
+void Compositor::UnmapSurface(Surface *s) {
+    if (!s->mapped) {
+        return;
+    }
+    AddDamage(Extent(*s));
+    s->mapped = false;
+    if (s->damage != None) {
+        XDamageDestroy(display_, s->damage);
+        s->damage = None;
+    }
+    if (s->pixmap != None) {
+        XFreePixmap(display_, s->pixmap);
+        s->pixmap = None;
+    }
+    DestroyShmImage(&s->shm);
+}
+
+void Compositor::Restack(Window w, Window sibling) {
+    auto it = FindSurface(w);
+    if (it == stack_.end()) {
+        return;
+    }
+    unique_ptr<Surface> s = ::std::move(*it);
+    stack_.erase(it);
+    if (sibling == None) {
+        stack_.insert(stack_.begin(), ::std::move(s));
+        return;
+    }
+    auto below = FindSurface(sibling);
+    stack_.insert(below == stack_.end() ? stack_.end() : below + 1, ::std::move(s));
+}
+
+Box Compositor::Extent(const Surface &s) const {
+    return s.shadow ? s.rect.Inflate(SHADOW_OFFSET, SHADOW_OFFSET) : s.rect;
+}
+
+void Compositor::AddDamage(const Box &r) {
+    damage_.Union(r);
+    // Past that, one large rectangle is cheaper to put than many small ones.
+    if (damage_.size() > MAX_DAMAGE_RECTS) {
+        damage_ = BoxRegion(damage_.extents());
+    }
+}
+
+void Compositor::DamageAll() {
+    damage_ = BoxRegion(screen_);
+}
+
+void Compositor::Fetch(Surface *s) {
+    if (s->shm.image == nullptr || s->pixmap == None) {
+        return;
+    }
+    XShmGetImage(display_, s->pixmap, s->shm.image, 0, 0, AllPlanes);
+    s->stale = false;
+}
+
+void Compositor::Composite(const Box &r) {
+    for (int y = r.y; y < r.bottom(); ++y) {
+        memcpy(Row(back_.image, r.x, y),
+               &wallpaper_[static_cast<size_t>(y) * screen_.width + r.x],
+               r.width * sizeof(uint32_t));
+    }
+
+    for (const auto &s : stack_) {
+        if (!s->mapped || s->shm.image == nullptr) {
+            continue;
+        }
+        if (s->shadow) {
+            const Box shadow = s->rect.Translate(SHADOW_OFFSET, SHADOW_OFFSET);
+            // Only the L-shaped part not covered by the window itself.
+            Box right = shadow;
+            right.x = s->rect.right();
+            right.width = SHADOW_OFFSET;
+            Box bottom = shadow;
+            bottom.y = s->rect.bottom();
+            bottom.height = SHADOW_OFFSET;
+            bottom.width -= SHADOW_OFFSET;
+            for (const Box &part : {right, bottom}) {
+                const Box c = part.Intersect(r);
+                for (int y = c.y; y < c.bottom(); ++y) {
+                    DarkenSpan(Row(back_.image, c.x, y), c.width, SHADOW_ALPHA);
+                }
+            }
+        }
+
+        const Box c = s->rect.Intersect(r);
+        for (int y = c.y; y < c.bottom(); ++y) {
+            uint32_t *dst = Row(back_.image, c.x, y);
+            const uint32_t *src = Row(s->shm.image, c.x - s->rect.x, y - s->rect.y);
+            if (s->argb) {
+                OverSpan(dst, src, c.width);
+            } else if (s->opacity == 255) {
+                memcpy(dst, src, c.width * sizeof(uint32_t));
+            } else {
+                BlendSpan(dst, src, c.width, s->opacity);
+            }
+        }
+    }
+}
+
+void Compositor::UpdateThumbnails() {
+    vector<Surface *> outdated;
+    for (auto &s : stack_) {
+        const Box &r = s->overview_rect;
+        if (r.empty() || s->shm.image == nullptr) {
+            continue;
+        }
+        if (!s->thumbnail_stale && s->thumbnail_width == r.width &&
+            s->thumbnail_height == r.height) {
+            continue;
+        }
+        if (s->stale) {
+            Fetch(s.get());
+        }
+        outdated.push_back(s.get());
+        AddDamage(r);
+    }
+
+    // The workers only read the images fetched above and write thumbnails.
+    workers_->ParallelFor(outdated.size(), [&outdated](size_t i) {
+        Surface *s = outdated[i];
+        const Box &r = s->overview_rect;
+        s->thumbnail.resize(static_cast<size_t>(r.width) * r.height);
+        DownscaleSampled(Row(s->shm.image, 0, 0), s->shm.image->bytes_per_line / 4,
+                         s->rect.width, s->rect.height,
+                         s->thumbnail.data(), r.width, r.width, r.height, THUMBNAIL_TAPS);
+        s->thumbnail_width = r.width;
+        s->thumbnail_height = r.height;
+        s->thumbnail_stale = false;
+    });
+}
+
+void Compositor::CompositeOverview(const Box &r) {
+    for (int y = r.y; y < r.bottom(); ++y) {
+        uint32_t *dst = Row(back_.image, r.x, y);
+        memcpy(dst, &wallpaper_[static_cast<size_t>(y) * screen_.width + r.x],
+               r.width * sizeof(uint32_t));
+        DarkenSpan(dst, r.width, OVERVIEW_DIM);
+    }
+
+    for (const auto &s : stack_) {
+        const Box &t = s->overview_rect;
+        if (t.empty() || s->thumbnail_width != t.width || s->thumbnail_height != t.height) {
+            continue;
+        }
+        const Box c = t.Intersect(r);
+        for (int y = c.y; y < c.bottom(); ++y) {
+            uint32_t *dst = Row(back_.image, c.x, y);
+            const uint32_t *src =
+                    &s->thumbnail[static_cast<size_t>(y - t.y) * t.width + (c.x - t.x)];
+            if (s->argb) {
+                OverSpan(dst, src, c.width);
+            } else {
+                memcpy(dst, src, c.width * sizeof(uint32_t));
+            }
+        }
+    }
+}
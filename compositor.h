@@ -0,0 +1,168 @@
+#ifndef SIMPLEWM_COMPOSITOR_H
+#define SIMPLEWM_COMPOSITOR_H
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+}
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "geometry_index.h"
+#include "region.h"
+#include "worker_pool.h"
+
+// Optional software compositor.
+//
+// All top-level windows are redirected with Composite. Damage reports which
+// parts of them changed; only those parts of the screen are recomposited
+// into a MIT-SHM back buffer with the SIMD kernels from blend.h and then
+// presented onto the Composite overlay window. A new frame is only
+// composited once the server has consumed the previous one.
+class Compositor {
+public:
+    Compositor(Display *display, Window root);
+
+    ~Compositor();
+
+    // Checks for Composite, Damage, XFixes and MIT-SHM and redirects the
+    // top-level windows. Returns false if compositing is not possible.
+    bool Init(Pixmap wallpaper);
+
+    // Tracks top-level windows from root substructure notifications. Returns
+    // true for events that only concern the compositor.
+    bool HandleEvent(const XEvent &e);
+
+    // Sets the opacity and shadow of a managed frame.
+    void Decorate(Window frame, uint8_t opacity, bool shadow);
+
+    // Re-reads the wallpaper, e.g. after it was changed.
+    void SetWallpaper(Pixmap wallpaper);
+
+    // Reallocates the back buffer after the root window was resized.
+    void Resize();
+
+    // Shows each of the given frames as a thumbnail at the given rectangle
+    // over the dimmed wallpaper instead of the windows, until HideOverview().
+    // Thumbnails follow the contents of their window while shown and are
+    // kept until the window is damaged.
+    void ShowOverview(const ::std::vector<::std::pair<Window, Box>> &thumbnails);
+
+    void HideOverview();
+
+    // Whether there is damage and the previous frame has been presented.
+    bool NeedsPaint() const { return !put_pending_ && !damage_.empty(); }
+
+    // Composites and presents all damage accumulated so far.
+    void Paint();
+
+private:
+    // Offset and darkness of frame shadows.
+    static const int SHADOW_OFFSET = 5;
+    static const uint8_t SHADOW_ALPHA = 80;
+    // Damage rectangles kept before they are merged into their extents.
+    static const size_t MAX_DAMAGE_RECTS = 16;
+    // Darkening of the wallpaper behind the overview.
+    static const uint8_t OVERVIEW_DIM = 128;
+    // Source pixels averaged per thumbnail pixel along each axis. Two keep
+    // downscaling 100 windows within the 50 ms the overview has to open.
+    static const int THUMBNAIL_TAPS = 2;
+
+    struct ShmImage {
+        XImage *image = nullptr;
+        XShmSegmentInfo info;
+    };
+
+    struct Surface {
+        Window window;
+        // Outer rectangle, including the border.
+        Box rect;
+        int border;
+        Visual *visual;
+        int depth;
+        bool argb;
+        bool mapped;
+        // Whether image is out of date with respect to the window contents.
+        bool stale;
+        uint8_t opacity;
+        bool shadow;
+        Damage damage;
+        Pixmap pixmap;
+        ShmImage shm;
+        // Where the overview shows the surface; empty if it does not.
+        Box overview_rect;
+        // Downscaled contents for the overview.
+        ::std::vector<uint32_t> thumbnail;
+        int thumbnail_width;
+        int thumbnail_height;
+        // Whether thumbnail is out of date with respect to the window contents.
+        bool thumbnail_stale;
+    };
+
+    bool CreateShmImage(Visual *visual, int depth, int width, int height, ShmImage *out);
+
+    void DestroyShmImage(ShmImage *image);
+
+    void AddSurface(Window w);
+
+    void RemoveSurface(Window w);
+
+    ::std::vector<::std::unique_ptr<Surface>>::iterator FindSurface(Window w);
+
+    void MapSurface(Surface *s);
+
+    void UnmapSurface(Surface *s);
+
+    // Places s directly above sibling, or at the bottom if sibling is None.
+    void Restack(Window w, Window sibling);
+
+    // Returns the rectangle a surface and its shadow cover.
+    Box Extent(const Surface &s) const;
+
+    void AddDamage(const Box &r);
+
+    void DamageAll();
+
+    // Copies the current contents of a surface into its image.
+    void Fetch(Surface *s);
+
+    void Composite(const Box &r);
+
+    // Fetches and downscales the contents of the surfaces whose thumbnail
+    // is out of date, the latter in parallel.
+    void UpdateThumbnails();
+
+    void CompositeOverview(const Box &r);
+
+    Display *display_;
+    const Window root_;
+    Window overlay_;
+    GC gc_;
+    int damage_event_base_;
+    int shm_completion_type_;
+    bool put_pending_;
+    Box screen_;
+
+    ShmImage back_;
+    Pixmap wallpaper_pixmap_;
+    ::std::vector<uint32_t> wallpaper_;
+
+    // Top-level windows, bottom to top.
+    ::std::vector<::std::unique_ptr<Surface>> stack_;
+    ::std::unordered_map<Window, ::std::pair<uint8_t, bool>> decorations_;
+    BoxRegion damage_;
+
+    bool overview_;
+    // Whether the first frame of the overview has been presented since it
+    // was shown at overview_shown_.
+    bool overview_presented_;
+    ::std::chrono::steady_clock::time_point overview_shown_;
+    // Started with the first overview.
+    ::std::unique_ptr<WorkerPool> workers_;
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "config.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glog/logging.h>
+
+using ::std::string;
+
+namespace {
+
+string Trim(const string &s) {
+    const size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == string::npos)
+        return "";
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool ParseInt(const string &value, int *out, long min = 0, long max = 1 << 20) {
+    char *end;
+    const long n = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || n < min || n > max)
+        return false;
+    *out = n;
+    return true;
+}
+
+bool ParseBool(const string &value, bool *out) {
+    if (value == "true" || value == "yes" || value == "1") {
+        *out = true;
+        return true;
+    }
+    if (value == "false" || value == "no" || value == "0") {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+bool ParseColor(const string &value, unsigned long *out) {
+    const char *digits = value.c_str();
+    if (value.size() == 7 && value[0] == '#')
+        digits += 1;
+    else if (value.size() == 8 && value.compare(0, 2, "0x") == 0)
+        digits += 2;
+    else
+        return false;
+    char *end;
+    const unsigned long color = strtoul(digits, &end, 16);
+    if (*end != '\0')
+        return false;
+    *out = color;
+    return true;
+}
+
+bool ParseKey(const string &value, KeyBinding *out) {
+    KeyBinding binding = {0, NoSymbol};
+    size_t begin = 0;
+    while (true) {
+        const size_t plus = value.find('+', begin);
+        const string part = value.substr(begin, plus == string::npos ? string::npos : plus - begin);
+        if (plus == string::npos) {
+            binding.keysym = XStringToKeysym(part.c_str());
+            break;
+        }
+        if (part == "Shift")
+            binding.modifiers |= ShiftMask;
+        else if (part == "Control" || part == "Ctrl")
+            binding.modifiers |= ControlMask;
+        else if (part == "Alt" || part == "Mod1")
+            binding.modifiers |= Mod1Mask;
+        else if (part == "Super" || part == "Mod4")
+            binding.modifiers |= Mod4Mask;
+        else
+            return false;
+        begin = plus + 1;
+    }
+    if (binding.keysym == NoSymbol)
+        return false;
+    *out = binding;
+    return true;
+}
+
+bool SetOption(const string &name, const string &value, Config *c) {
+    if (name == "snap_threshold")
+        return ParseInt(value, &c->snap_threshold);
+    if (name == "frame_radius")
+        return ParseInt(value, &c->frame_radius);
+    if (name == "see_through_border")
+        return ParseBool(value, &c->see_through_border);
+    if (name == "compositing")
+        return ParseBool(value, &c->compositing);
+    if (name == "frame_opacity")
+        return ParseInt(value, &c->frame_opacity, 0, 255);
+    if (name == "shadows")
+        return ParseBool(value, &c->shadows);
+    if (name == "paint_interval_ms")
+        return ParseInt(value, &c->paint_interval_ms);
+    if (name == "ping_interval_ms")
+        return ParseInt(value, &c->ping_interval_ms);
+    if (name == "ping_timeout_ms")
+        return ParseInt(value, &c->ping_timeout_ms);
+    if (name == "restore_session")
+        return ParseBool(value, &c->restore_session);
+    if (name == "focus_follows_mouse")
+        return ParseBool(value, &c->focus_follows_mouse);
+    if (name == "focus_delay_ms")
+        return ParseInt(value, &c->focus_delay_ms);
+    if (name == "xinput_drag")
+        return ParseBool(value, &c->xinput_drag);
+    if (name == "border_color")
+        return ParseColor(value, &c->border_color);
+    if (name == "hung_border_color")
+        return ParseColor(value, &c->hung_border_color);
+    if (name == "frame_color")
+        return ParseColor(value, &c->frame_color);
+    if (name == "title_color")
+        return ParseColor(value, &c->title_color);
+    if (name == "title_height")
+        // The icons are 20 pixels high.
+        return ParseInt(value, &c->title_height, 22);
+    if (name == "wallpaper" && !value.empty()) {
+        c->wallpaper = value;
+        return true;
+    }
+    if (name == "close_key")
+        return ParseKey(value, &c->close_key);
+    if (name == "cycle_key")
+        return ParseKey(value, &c->cycle_key);
+    if (name == "overview_key")
+        return ParseKey(value, &c->overview_key);
+    return false;
+}
+
+}
+
+bool ReadConfigFile(const string &path, Config *config) {
+    ::std::ifstream in(path);
+    if (!in)
+        return false;
+    string line;
+    for (int number = 1; ::std::getline(in, line); ++number) {
+        line = Trim(line);
+        // Only whole lines are comments, as colours start with '#' too.
+        if (line.empty() || line[0] == '#')
+            continue;
+        const size_t eq = line.find('=');
+        if (eq == string::npos || !SetOption(Trim(line.substr(0, eq)), Trim(line.substr(eq + 1)), config))
+            LOG(WARNING) << path << ":" << number << ": ignoring malformed setting";
+    }
+    return true;
+}
+
+string ConfigPath() {
+    const char *path = getenv("SIMPLEWM_CONFIG");
+    if (path != nullptr && *path != '\0')
+        return path;
+    const char *config = getenv("XDG_CONFIG_HOME");
+    if (config != nullptr && *config != '\0')
+        return string(config) + "/simplewm/config";
+    const char *home = getenv("HOME");
+    return string(home != nullptr ? home : "/tmp") + "/.config/simplewm/config";
+}
@@ -0,0 +1,110 @@
+#ifndef SIMPLEWM_CONFIG_H
+#define SIMPLEWM_CONFIG_H
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+}
+#include <string>
+
+// A key together with the modifiers that have to be held.
+struct KeyBinding {
+    unsigned int modifiers;
+    KeySym keysym;
+
+    bool operator==(const KeyBinding &o) const {
+        return modifiers == o.modifiers && keysym == o.keysym;
+    }
+    bool operator!=(const KeyBinding &o) const { return !(*this == o); }
+};
+
+// User-tunable settings of the window manager.
+//
+// The window manager holds the current settings as an immutable snapshot.
+// Editing the config file replaces the snapshot, and only what differs from
+// the previous one is applied.
+struct Config {
+    // Distance in pixels within which a dragged frame snaps to screen edges
+    // and to the edges of other frames. 0 disables snapping.
+    int snap_threshold = 10;
+
+    // Radius in pixels of the rounded frame corners. 0 disables shaping.
+    int frame_radius = 6;
+
+    // Whether the desktop and windows below show through frame borders.
+    bool see_through_border = false;
+
+    // Whether to run the built-in software compositor.
+    bool compositing = false;
+
+    // Opacity of managed frames when compositing, from 0 to 255.
+    int frame_opacity = 235;
+
+    // Whether managed frames cast a shadow when compositing.
+    bool shadows = true;
+
+    // Minimum time between two composited frames, in milliseconds.
+    int paint_interval_ms = 16;
+
+    // Interval in milliseconds at which clients supporting _NET_WM_PING are
+    // checked for liveness. 0 only pings clients that are asked to close.
+    int ping_interval_ms = 5000;
+
+    // Time in milliseconds a client has to answer a ping before its frame is
+    // marked as not responding. A client that was asked to close and does
+    // not answer in time is killed.
+    int ping_timeout_ms = 2000;
+
+    // Whether windows are restored to the geometry they last had, by
+    // WM_CLASS and WM_WINDOW_ROLE, from the session file.
+    bool restore_session = true;
+
+    // Whether the focus follows the pointer instead of clicks. Clicks into
+    // a window always focus it.
+    bool focus_follows_mouse = false;
+
+    // Time in milliseconds the pointer has to rest on a window before it
+    // gets the focus when the focus follows the pointer.
+    int focus_delay_ms = 40;
+
+    // Whether title bar drags track the pointer through XInput 2 when the
+    // server has it, rather than through core motion events. Off until
+    // drag_bench.sh shows it ahead of core events.
+    bool xinput_drag = false;
+
+    // Colours as 0xRRGGBB.
+    unsigned long border_color = 0x7a7a7a;
+    // Border of frames whose client does not answer pings.
+    unsigned long hung_border_color = 0xc0392b;
+    unsigned long frame_color = 0x3b414a;
+    unsigned long title_color = 0x646375;
+
+    // Height of the title bar in pixels.
+    int title_height = 26;
+
+    // XPM image shown on the root window.
+    ::std::string wallpaper = "./resources/LinusTorvalds.xpm";
+
+    // Closes the focused window.
+    KeyBinding close_key = {Mod1Mask, XK_F4};
+
+    // Focuses the next window on the current workspace.
+    KeyBinding cycle_key = {Mod1Mask, XK_Tab};
+
+    // Shows the windows of the current workspace side by side to pick one
+    // with the pointer. Needs compositing.
+    KeyBinding overview_key = {Mod4Mask, XK_Tab};
+};
+
+// Overlays the settings in a config file on config. The file has one
+// "name = value" line per setting, named like the fields of Config, and
+// lines starting with "#" are comments. Colours are written as #rrggbb and keys as e.g.
+// Alt+F4. Returns false if the file cannot be read; malformed lines are
+// logged and skipped.
+bool ReadConfigFile(const ::std::string &path, Config *config);
+
+// Returns the config file: $SIMPLEWM_CONFIG if set, otherwise
+// simplewm/config in $XDG_CONFIG_HOME or ~/.config.
+::std::string ConfigPath();
+
+#endif
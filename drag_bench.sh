@@ -0,0 +1,41 @@
+# Measures the motion-to-move latency of title bar drags under Xvfb, once
+# through XInput 2 and once through core motion events, e.g.
+#     ./drag_bench.sh 500
+# Needs Xvfb, xterm and xdotool. Prints the "Drag through" summary the
+# window manager logs at the end of each drag.
+set -e
+for TOOL in Xvfb xterm xdotool; do
+    if ! command -v $TOOL > /dev/null; then
+        echo "drag_bench.sh needs $TOOL" >&2
+        exit 1
+    fi
+done
+make main
+MOVES=${1:-300}
+BENCH_DISPLAY=:101
+TMP=$(mktemp -d)
+Xvfb $BENCH_DISPLAY -screen 0 1280x720x24 -nolisten tcp &
+XVFB=$!
+trap 'kill $XVFB 2>/dev/null; rm -rf "$TMP"' EXIT
+sleep 1
+
+export DISPLAY=$BENCH_DISPLAY GLOG_logtostderr=1 HOME=$TMP
+STEPS=""
+for i in $(seq "$MOVES"); do
+    STEPS="$STEPS mousemove_relative 1 1 sleep 0.005"
+done
+for MODE in true false; do
+    echo "xinput_drag = $MODE" > "$TMP/config"
+    SIMPLEWM_CONFIG="$TMP/config" ./main 2> "$TMP/log" &
+    WM=$!
+    sleep 1
+    # A requested position puts the title bar at y 100 to 126.
+    xterm -geometry 80x24+100+100 &
+    CLIENT=$!
+    sleep 1
+    xdotool mousemove 300 110 mousedown 1 $STEPS mouseup 1
+    sleep 0.5
+    echo "xinput_drag = $MODE: $(grep -o 'Drag through.*' "$TMP/log")"
+    kill $CLIENT $WM
+    wait $WM 2>/dev/null || true
+done
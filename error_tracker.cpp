@@ -0,0 +1,149 @@
+#include "error_tracker.h"
+#include <algorithm>
+#include <cstring>
+#include "util.h"
+
+using ::std::function;
+using ::std::string;
+
+namespace {
+
+// Names of the minor opcodes of the extensions the window manager uses,
+// starting at minor opcode first.
+struct ExtensionRequests {
+    const char *extension;
+    int first;
+    ::std::vector<const char *> names;
+};
+
+const ExtensionRequests EXTENSION_REQUESTS[] = {
+        {"MIT-SHM", 0,
+         {"QueryVersion", "Attach", "Detach", "PutImage", "GetImage", "CreatePixmap",
+          "AttachFd", "CreateSegment"}},
+        {"SHAPE", 0,
+         {"QueryVersion", "Rectangles", "Mask", "Combine", "Offset", "QueryExtents",
+          "SelectInput", "InputSelected", "GetRectangles"}},
+        {"Composite", 0,
+         {"QueryVersion", "RedirectWindow", "RedirectSubwindows", "UnredirectWindow",
+          "UnredirectSubwindows", "CreateRegionFromBorderClip", "NameWindowPixmap",
+          "GetOverlayWindow", "ReleaseOverlayWindow"}},
+        {"DAMAGE", 0, {"QueryVersion", "Create", "Destroy", "Subtract", "Add"}},
+        {"XFIXES", 0,
+         {"QueryVersion", "ChangeSaveSet", "SelectSelectionInput", "SelectCursorInput",
+          "GetCursorImage", "CreateRegion", "CreateRegionFromBitmap", "CreateRegionFromWindow",
+          "CreateRegionFromGC", "CreateRegionFromPicture", "DestroyRegion", "SetRegion",
+          "CopyRegion", "UnionRegion", "IntersectRegion", "SubtractRegion", "InvertRegion",
+          "TranslateRegion", "RegionExtents", "FetchRegion", "SetGCClipRegion",
+          "SetWindowShapeRegion", "SetPictureClipRegion"}},
+        {"XInputExtension", 40,
+         {"XIQueryPointer", "XIWarpPointer", "XIChangeCursor", "XIChangeHierarchy",
+          "XISetClientPointer", "XIGetClientPointer", "XISelectEvents", "XIQueryVersion",
+          "XIQueryDevice", "XISetFocus", "XIGetFocus", "XIGrabDevice", "XIUngrabDevice",
+          "XIAllowEvents", "XIPassiveGrabDevice", "XIPassiveUngrabDevice"}},
+};
+
+}
+
+ErrorTracker::Scope::Scope(ErrorTracker *tracker, Display *display, Operation operation,
+                           Window client)
+    : tracker_(tracker),
+      display_(display),
+      previous_operation_(tracker->spans_.back().operation),
+      previous_client_(tracker->spans_.back().client) {
+    tracker_->Begin(NextRequest(display_), operation, client);
+}
+
+ErrorTracker::Scope::~Scope() {
+    tracker_->Begin(NextRequest(display_), previous_operation_, previous_client_);
+}
+
+ErrorTracker::ErrorTracker() {
+    spans_.push_back(Span{0, NONE, None});
+}
+
+void ErrorTracker::Begin(unsigned long serial, Operation operation, Window client) {
+    Span &last = spans_.back();
+    if (last.operation == operation && last.client == client) {
+        return;
+    }
+    // An operation that sent no requests leaves no span.
+    if (last.serial == serial) {
+        spans_.pop_back();
+        if (!spans_.empty() && spans_.back().operation == operation &&
+            spans_.back().client == client) {
+            return;
+        }
+    }
+    spans_.push_back(Span{serial, operation, client});
+}
+
+bool ErrorTracker::Report(const XErrorEvent &e) {
+    auto it = ::std::upper_bound(
+            spans_.begin(), spans_.end(), e.serial,
+            [](unsigned long serial, const Span &span) { return serial < span.serial; });
+    if (it == spans_.begin() || (it - 1)->operation == NONE) {
+        return false;
+    }
+    --it;
+    failures_.push_back(Failure{it->operation, it->client, e.serial, e.error_code,
+                                e.request_code, e.minor_code, e.resourceid});
+    return true;
+}
+
+void ErrorTracker::Dispatch(unsigned long processed, const function<void(const Failure &)> &failed) {
+    // Handling a failure may read more errors from the connection.
+    ::std::vector<Failure> failures;
+    failures.swap(failures_);
+    for (const Failure &f : failures) {
+        failed(f);
+    }
+    // Errors for requests up to processed have all been read.
+    while (spans_.size() > 1 && spans_[1].serial <= processed + 1) {
+        spans_.pop_front();
+    }
+}
+
+void ErrorTracker::NameExtensions(Display *display) {
+    int n = 0;
+    char **names = XListExtensions(display, &n);
+    for (int i = 0; i < n; ++i) {
+        int opcode, event, error;
+        if (XQueryExtension(display, names[i], &opcode, &event, &error)) {
+            extensions_[static_cast<uint8_t>(opcode)] = names[i];
+        }
+    }
+    if (names != nullptr) {
+        XFreeExtensionList(names);
+    }
+}
+
+string ErrorTracker::RequestName(uint8_t request_code, uint8_t minor_code) const {
+    auto extension = extensions_.find(request_code);
+    if (extension == extensions_.end()) {
+        return XRequestCodeToString(request_code);
+    }
+    for (const ExtensionRequests &requests : EXTENSION_REQUESTS) {
+        const int index = minor_code - requests.first;
+        if (extension->second == requests.extension && index >= 0 &&
+            index < static_cast<int>(requests.names.size())) {
+            return extension->second + "." + requests.names[index];
+        }
+    }
+    return extension->second + "." + ToString(static_cast<int>(minor_code));
+}
+
+const char *ErrorTracker::OperationName(Operation operation) {
+    switch (operation) {
+        case NONE:
+            return "none";
+        case FRAME:
+            return "framing";
+        case UNFRAME:
+            return "unframing";
+        case CONFIGURE:
+            return "configuring";
+        case FOCUS:
+            return "focusing";
+    }
+    return "unknown";
+}
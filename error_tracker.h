@@ -0,0 +1,102 @@
+#ifndef SIMPLEWM_ERROR_TRACKER_H
+#define SIMPLEWM_ERROR_TRACKER_H
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Matches asynchronous X errors back to the operation that caused them.
+//
+// The requests the window manager sends are attributed to operations on
+// clients by the serial of the first request of each operation. An error
+// carries the serial of the failed request, so it is matched with a binary
+// search instead of an XSync after every operation. The matched failures
+// are handed out from the main loop, where the window manager may send
+// requests again, e.g. to roll back a frame whose client died meanwhile.
+class ErrorTracker {
+public:
+    enum Operation : uint8_t {
+        // Requests not sent for a tracked operation.
+        NONE,
+        // Reparenting a client into a new frame and mapping it.
+        FRAME,
+        // Reparenting a client back to the root window.
+        UNFRAME,
+        // Moving or resizing a client or its frame.
+        CONFIGURE,
+        FOCUS,
+    };
+
+    struct Failure {
+        Operation operation;
+        // Client window the operation was for.
+        Window client;
+        unsigned long serial;
+        uint8_t error_code;
+        uint8_t request_code;
+        uint8_t minor_code;
+        XID resource;
+    };
+
+    // Attributes the requests sent during its lifetime to an operation on a
+    // client, and those sent after it to the enclosing operation.
+    class Scope {
+    public:
+        Scope(ErrorTracker *tracker, Display *display, Operation operation, Window client);
+
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        ErrorTracker *tracker_;
+        Display *display_;
+        Operation previous_operation_;
+        Window previous_client_;
+    };
+
+    ErrorTracker();
+
+    // Attributes the requests from serial on to operation on client.
+    void Begin(unsigned long serial, Operation operation, Window client);
+
+    // Notes the failure of an error's operation. Sends no requests, so it may
+    // be called from the Xlib error handler. Returns false if the failed
+    // request belonged to no operation.
+    bool Report(const XErrorEvent &e);
+
+    // Calls failed for every failure reported so far, then forgets the
+    // operations the server has processed all requests of.
+    void Dispatch(unsigned long processed, const ::std::function<void(const Failure &)> &failed);
+
+    // Learns the major opcodes of the extensions of a display.
+    void NameExtensions(Display *display);
+
+    // Returns the name of a request, e.g. "ConfigureWindow" or
+    // "SHAPE.Rectangles".
+    ::std::string RequestName(uint8_t request_code, uint8_t minor_code) const;
+
+    static const char *OperationName(Operation operation);
+
+private:
+    struct Span {
+        // Serial of the first request of the span.
+        unsigned long serial;
+        Operation operation;
+        Window client;
+    };
+
+    // Ordered by serial. The last span lasts until the next Begin().
+    ::std::deque<Span> spans_;
+    ::std::vector<Failure> failures_;
+    ::std::unordered_map<uint8_t, ::std::string> extensions_;
+};
+
+#endif
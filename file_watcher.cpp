@@ -0,0 +1,85 @@
+#include "file_watcher.h"
+extern "C" {
+#include <sys/inotify.h>
+#include <unistd.h>
+}
+#include <cerrno>
+#include <cstring>
+#include <glog/logging.h>
+
+using ::std::string;
+using ::std::vector;
+
+FileWatcher::FileWatcher()
+    : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+    if (fd_ < 0) {
+        PLOG(ERROR) << "inotify_init1";
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool FileWatcher::Watch(const string &path) {
+    if (fd_ < 0) {
+        return false;
+    }
+    const size_t slash = path.rfind('/');
+    const string dir = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    const int wd = inotify_add_watch(
+            fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+    if (wd < 0) {
+        PLOG(INFO) << "Not watching " << path;
+        return false;
+    }
+    files_.push_back(File{wd, path.substr(slash + 1), path});
+    LOG(INFO) << "Watching " << path;
+    return true;
+}
+
+void FileWatcher::AddPollFds(vector<pollfd> *fds) const {
+    if (fd_ >= 0 && !files_.empty()) {
+        fds->push_back(pollfd{fd_, POLLIN, 0});
+    }
+}
+
+void FileWatcher::Dispatch(const vector<pollfd> &fds,
+                           const ::std::function<void(const string &)> &changed) {
+    bool ready = false;
+    for (const pollfd &p : fds) {
+        ready = ready || (p.fd == fd_ && p.revents != 0);
+    }
+    if (!ready) {
+        return;
+    }
+
+    // An editor saving a file causes a burst of events, reported once.
+    vector<bool> dirty(files_.size(), false);
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        const ssize_t n = read(fd_, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n;) {
+            const inotify_event *e = reinterpret_cast<const inotify_event *>(buffer + i);
+            for (size_t f = 0; f < files_.size(); ++f) {
+                if (files_[f].wd == e->wd && e->len > 0 && files_[f].name == e->name) {
+                    dirty[f] = true;
+                }
+            }
+            i += sizeof(inotify_event) + e->len;
+        }
+    }
+    for (size_t f = 0; f < files_.size(); ++f) {
+        if (dirty[f]) {
+            changed(files_[f].path);
+        }
+    }
+}
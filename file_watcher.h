@@ -0,0 +1,47 @@
+#ifndef SIMPLEWM_FILE_WATCHER_H
+#define SIMPLEWM_FILE_WATCHER_H
+
+extern "C" {
+#include <poll.h>
+}
+#include <functional>
+#include <string>
+#include <vector>
+
+// Reports changes to files through inotify.
+//
+// The directories of the files are watched rather than the files, so that
+// files replaced by a rename, as most editors save them, or created later
+// are noticed too. Like IpcServer, the watcher never blocks and its file
+// descriptor is polled by the main loop next to the X connection.
+class FileWatcher {
+public:
+    FileWatcher();
+
+    ~FileWatcher();
+
+    // Starts watching path. Returns false if its directory cannot be
+    // watched, e.g. because it does not exist.
+    bool Watch(const ::std::string &path);
+
+    // Appends the descriptor the watcher waits on to fds.
+    void AddPollFds(::std::vector<pollfd> *fds) const;
+
+    // Reads the pending notifications if the descriptor is ready in fds and
+    // calls changed once for every watched file that was written, replaced
+    // or removed since.
+    void Dispatch(const ::std::vector<pollfd> &fds,
+                  const ::std::function<void(const ::std::string &)> &changed);
+
+private:
+    struct File {
+        int wd;
+        ::std::string name;
+        ::std::string path;
+    };
+
+    int fd_;
+    ::std::vector<File> files_;
+};
+
+#endif
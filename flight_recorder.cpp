@@ -0,0 +1,159 @@
+#include "flight_recorder.h"
+extern "C" {
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+}
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glog/logging.h>
+
+using ::std::string;
+
+FlightRecord FlightRecorder::records_[FlightRecorder::CAPACITY];
+::std::atomic<uint64_t> FlightRecorder::head_(0);
+
+namespace {
+
+const int FATAL_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+// Filled in by Install() so that dumping does not allocate.
+char dump_path[256];
+::std::atomic_flag dumped = ATOMIC_FLAG_INIT;
+
+bool WriteAll(int fd, const void *data, size_t size) {
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        const ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void OnFatalSignal(int signal) {
+    FlightRecorder::Dump(signal);
+    // The handler was installed with SA_RESETHAND, so this terminates the
+    // process the way the signal would have.
+    raise(signal);
+}
+
+void OnCheckFailure() {
+    FlightRecorder::Dump(0);
+    abort();
+}
+
+}
+
+void FlightRecorder::Install(const string &path) {
+    snprintf(dump_path, sizeof(dump_path), "%s", path.c_str());
+    ::google::InstallFailureFunction(&OnCheckFailure);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &OnFatalSignal;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (int signal : FATAL_SIGNALS) {
+        sigaction(signal, &action, nullptr);
+    }
+    LOG(INFO) << "Flight recorder dumps to " << dump_path;
+}
+
+void FlightRecorder::RecordEvent(const XEvent &e) {
+    unsigned long window = e.xany.window;
+    unsigned long arg = 0;
+    uint16_t detail = 0;
+    switch (e.type) {
+        case CreateNotify:
+            window = e.xcreatewindow.window;
+            arg = e.xcreatewindow.parent;
+            break;
+        case DestroyNotify:
+            window = e.xdestroywindow.window;
+            arg = e.xdestroywindow.event;
+            break;
+        case UnmapNotify:
+            window = e.xunmap.window;
+            arg = e.xunmap.event;
+            break;
+        case MapNotify:
+            window = e.xmap.window;
+            arg = e.xmap.event;
+            break;
+        case ReparentNotify:
+            window = e.xreparent.window;
+            arg = e.xreparent.parent;
+            break;
+        case ConfigureNotify:
+            window = e.xconfigure.window;
+            arg = e.xconfigure.event;
+            break;
+        case MapRequest:
+            window = e.xmaprequest.window;
+            arg = e.xmaprequest.parent;
+            break;
+        case ConfigureRequest:
+            window = e.xconfigurerequest.window;
+            arg = e.xconfigurerequest.parent;
+            detail = e.xconfigurerequest.value_mask;
+            break;
+        case ButtonPress:
+        case ButtonRelease:
+            detail = e.xbutton.button;
+            break;
+        case KeyPress:
+        case KeyRelease:
+            detail = e.xkey.keycode;
+            break;
+        case PropertyNotify:
+            arg = e.xproperty.atom;
+            break;
+        case ClientMessage:
+            arg = e.xclient.message_type;
+            break;
+    }
+    Record(FlightRecord::EVENT, e.type, detail, e.xany.serial, window, arg);
+}
+
+void FlightRecorder::Dump(int signal) {
+    if (dumped.test_and_set() || dump_path[0] == '\0')
+        return;
+    const int fd = open(dump_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return;
+
+    FlightDumpHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SWMFLT1", 8);
+    header.record_size = sizeof(FlightRecord);
+    header.capacity = CAPACITY;
+    header.head = head_.load(::std::memory_order_acquire);
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    header.time_us = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+    header.signal = signal;
+
+    WriteAll(fd, &header, sizeof(header));
+    WriteAll(fd, records_, sizeof(records_));
+    close(fd);
+
+    static const char MESSAGE[] = "simplewm: flight recorder dumped to ";
+    WriteAll(STDERR_FILENO, MESSAGE, sizeof(MESSAGE) - 1);
+    WriteAll(STDERR_FILENO, dump_path, strlen(dump_path));
+    WriteAll(STDERR_FILENO, "\n", 1);
+}
+
+string FlightRecorderPath() {
+    const char *path = getenv("SIMPLEWM_FLIGHT_RECORDER");
+    if (path != nullptr && *path != '\0')
+        return path;
+    return "/tmp/simplewm-" + ::std::to_string(getpid()) + ".flight";
+}
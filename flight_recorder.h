@@ -0,0 +1,102 @@
+#ifndef SIMPLEWM_FLIGHT_RECORDER_H
+#define SIMPLEWM_FLIGHT_RECORDER_H
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <time.h>
+}
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// One entry of the flight recorder, 32 bytes.
+struct FlightRecord {
+    enum Kind : uint8_t {
+        // An X event; code is the event type.
+        EVENT = 1,
+        // A request sent by the window manager; code is its major opcode.
+        REQUEST = 2,
+        // An X error; code is the error code and detail the major opcode of
+        // the failed request.
+        ERROR = 3,
+    };
+
+    // Position in the recording plus one; 0 while the record is written.
+    ::std::atomic<uint64_t> sequence;
+    // CLOCK_MONOTONIC in microseconds.
+    uint64_t time_us;
+    // Serial of the event, of the request or of the failed request.
+    uint32_t serial;
+    uint8_t kind;
+    uint8_t code;
+    uint16_t detail;
+    uint32_t window;
+    uint32_t arg;
+};
+
+// Header of a flight recorder dump, followed by CAPACITY raw records.
+struct FlightDumpHeader {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t capacity;
+    // Number of records written so far; the newest one has sequence head.
+    uint64_t head;
+    // CLOCK_MONOTONIC at the time of the dump, in microseconds.
+    uint64_t time_us;
+    // Signal that caused the dump, or 0 for a failed CHECK.
+    int32_t signal;
+    uint32_t reserved;
+};
+
+// Always-on, in-memory ring buffer of the most recent events, requests and
+// errors, written to disk when the window manager dies.
+//
+// Recording is a relaxed fetch_add and a handful of stores into a static
+// buffer, so it can stay enabled in production instead of verbose logging.
+// The buffer is dumped from a glog failure function and from handlers of
+// fatal signals using only async-signal-safe calls; simplewm-flight decodes
+// the dump.
+class FlightRecorder {
+public:
+    // Number of records kept. Must be a power of two.
+    static const uint32_t CAPACITY = 8192;
+
+    // Installs the CHECK failure function and fatal signal handlers that
+    // dump the buffer to path.
+    static void Install(const ::std::string &path);
+
+    static void Record(uint8_t kind, uint8_t code, uint16_t detail,
+                       uint32_t serial, unsigned long window, unsigned long arg) {
+        const uint64_t n = head_.fetch_add(1, ::std::memory_order_relaxed);
+        FlightRecord &r = records_[n & (CAPACITY - 1)];
+        r.sequence.store(0, ::std::memory_order_relaxed);
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        r.time_us = now.tv_sec * 1000000ull + now.tv_nsec / 1000;
+        r.serial = serial;
+        r.kind = kind;
+        r.code = code;
+        r.detail = detail;
+        r.window = window;
+        r.arg = arg;
+        r.sequence.store(n + 1, ::std::memory_order_release);
+    }
+
+    // Records an event with the window it is about as window and, for
+    // substructure notifications, the window it was reported on as arg.
+    static void RecordEvent(const XEvent &e);
+
+    // Writes the buffer to the installed path. Async-signal-safe; only the
+    // first call has an effect.
+    static void Dump(int signal);
+
+private:
+    static FlightRecord records_[CAPACITY];
+    static ::std::atomic<uint64_t> head_;
+};
+
+// Returns where the flight recorder is dumped: $SIMPLEWM_FLIGHT_RECORDER if
+// set, otherwise /tmp/simplewm-<pid>.flight.
+::std::string FlightRecorderPath();
+
+#endif
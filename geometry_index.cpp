@@ -0,0 +1,216 @@
+#include "geometry_index.h"
+#include <algorithm>
+
+using ::std::vector;
+
+namespace {
+
+// Division rounding towards negative infinity, for frames left of or above
+// the root window origin.
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+}
+
+GeometryIndex::GeometryIndex()
+    : stacking_(0),
+      query_(0) {
+}
+
+GeometryIndex::CellRange GeometryIndex::Cells(const Box &r) {
+    CellRange c;
+    c.x0 = FloorDiv(r.x, CELL_SIZE);
+    c.y0 = FloorDiv(r.y, CELL_SIZE);
+    c.x1 = FloorDiv(r.right() - 1, CELL_SIZE);
+    c.y1 = FloorDiv(r.bottom() - 1, CELL_SIZE);
+    return c;
+}
+
+void GeometryIndex::Update(Window frame, const Box &outer) {
+    const uint32_t *it = slots_.Find(frame);
+    if (it == nullptr) {
+        uint32_t slot;
+        if (!free_.empty()) {
+            slot = free_.back();
+            free_.pop_back();
+        } else {
+            slot = entries_.size();
+            entries_.emplace_back();
+        }
+        Entry &e = entries_[slot];
+        e.frame = frame;
+        e.rect = outer;
+        e.stacking = ++stacking_;
+        e.mapped = true;
+        e.visited = 0;
+        slots_.Insert(frame, slot);
+        Link(slot);
+        return;
+    }
+
+    Entry &e = entries_[*it];
+    if (e.mapped) {
+        const CellRange before = Cells(e.rect);
+        const CellRange after = Cells(outer);
+        if (before.x0 != after.x0 || before.y0 != after.y0 ||
+            before.x1 != after.x1 || before.y1 != after.y1) {
+            Unlink(*it);
+            e.rect = outer;
+            Link(*it);
+            return;
+        }
+    }
+    e.rect = outer;
+}
+
+void GeometryIndex::Remove(Window frame) {
+    const uint32_t *it = slots_.Find(frame);
+    if (it == nullptr) {
+        return;
+    }
+    const uint32_t slot = *it;
+    if (entries_[slot].mapped) {
+        Unlink(slot);
+    }
+    entries_[slot].frame = None;
+    free_.push_back(slot);
+    slots_.Erase(frame);
+}
+
+void GeometryIndex::SetMapped(Window frame, bool mapped) {
+    const uint32_t *it = slots_.Find(frame);
+    if (it == nullptr || entries_[*it].mapped == mapped) {
+        return;
+    }
+    if (mapped) {
+        entries_[*it].mapped = true;
+        Link(*it);
+    } else {
+        Unlink(*it);
+        entries_[*it].mapped = false;
+    }
+}
+
+void GeometryIndex::Raise(Window frame) {
+    const uint32_t *it = slots_.Find(frame);
+    if (it != nullptr) {
+        entries_[*it].stacking = ++stacking_;
+    }
+}
+
+void GeometryIndex::Restack(Window frame, Window sibling) {
+    const uint32_t *it = slots_.Find(frame);
+    if (it == nullptr) {
+        return;
+    }
+    uint64_t below = 0;
+    if (sibling != None) {
+        const uint32_t *s = slots_.Find(sibling);
+        if (s == nullptr) {
+            return;
+        }
+        below = entries_[*s].stacking;
+    }
+    Entry &e = entries_[*it];
+    // Already right above the sibling: nothing to renumber.
+    if (e.stacking == below + 1) {
+        return;
+    }
+    // Open a gap above the sibling. Stamps are only compared, so they may
+    // run ahead; frames are few enough for a linear pass.
+    for (Entry &other : entries_) {
+        if (other.frame != None && other.stacking > below) {
+            ++other.stacking;
+        }
+    }
+    e.stacking = below + 1;
+    ++stacking_;
+}
+
+void GeometryIndex::SortByStacking(vector<Window> *frames) const {
+    auto stacking = [this](Window frame) -> uint64_t {
+        const uint32_t *it = slots_.Find(frame);
+        return it == nullptr ? 0 : entries_[*it].stacking;
+    };
+    ::std::stable_sort(frames->begin(), frames->end(), [&stacking](Window a, Window b) {
+        return stacking(a) < stacking(b);
+    });
+}
+
+bool GeometryIndex::Get(Window frame, Box *outer) const {
+    const uint32_t *it = slots_.Find(frame);
+    if (it == nullptr) {
+        return false;
+    }
+    *outer = entries_[*it].rect;
+    return true;
+}
+
+void GeometryIndex::Query(const Box &r, vector<Window> *out) const {
+    if (r.width <= 0 || r.height <= 0) {
+        return;
+    }
+    const uint64_t stamp = ++query_;
+    const CellRange c = Cells(r);
+    for (int cx = c.x0; cx <= c.x1; ++cx) {
+        for (int cy = c.y0; cy <= c.y1; ++cy) {
+            auto cell = cells_.find(CellKey(cx, cy));
+            if (cell == cells_.end()) {
+                continue;
+            }
+            for (uint32_t slot : cell->second) {
+                const Entry &e = entries_[slot];
+                if (e.visited != stamp) {
+                    e.visited = stamp;
+                    if (e.rect.Intersects(r)) {
+                        out->push_back(e.frame);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void GeometryIndex::All(vector<Box> *out) const {
+    for (const Entry &e : entries_) {
+        if (e.frame != None && e.mapped) {
+            out->push_back(e.rect);
+        }
+    }
+}
+
+void GeometryIndex::Link(uint32_t slot) {
+    const Entry &e = entries_[slot];
+    if (e.rect.width <= 0 || e.rect.height <= 0) {
+        return;
+    }
+    const CellRange c = Cells(e.rect);
+    for (int cx = c.x0; cx <= c.x1; ++cx) {
+        for (int cy = c.y0; cy <= c.y1; ++cy) {
+            cells_[CellKey(cx, cy)].push_back(slot);
+        }
+    }
+}
+
+void GeometryIndex::Unlink(uint32_t slot) {
+    const Entry &e = entries_[slot];
+    if (e.rect.width <= 0 || e.rect.height <= 0) {
+        return;
+    }
+    const CellRange c = Cells(e.rect);
+    for (int cx = c.x0; cx <= c.x1; ++cx) {
+        for (int cy = c.y0; cy <= c.y1; ++cy) {
+            auto cell = cells_.find(CellKey(cx, cy));
+            if (cell == cells_.end()) {
+                continue;
+            }
+            vector<uint32_t> &slots = cell->second;
+            auto pos = ::std::find(slots.begin(), slots.end(), slot);
+            if (pos != slots.end()) {
+                *pos = slots.back();
+                slots.pop_back();
+            }
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef SIMPLEWM_GEOMETRY_INDEX_H
+#define SIMPLEWM_GEOMETRY_INDEX_H
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "util.h"
+#include "window_table.h"
+
+// An axis-aligned rectangle in root window coordinates.
+typedef Rect<int> Box;
+
+// In-process spatial index over frame rectangles, so that snapping and
+// placement never have to ask the X server where things are.
+//
+// Frames are bucketed into a uniform grid of CELL_SIZE pixel cells;
+// rectangle queries only touch the cells they cover. Every indexed frame
+// also carries a stacking stamp, kept in step with the server's stacking
+// order from ConfigureNotify, so that frames can be sorted bottom to top.
+class GeometryIndex {
+public:
+    static const int CELL_SIZE = 128;
+
+    GeometryIndex();
+
+    // Adds a frame or updates its rectangle. New frames are stacked on top.
+    void Update(Window frame, const Box &outer);
+
+    void Remove(Window frame);
+
+    // Unmapped frames keep their geometry but are not returned by queries.
+    void SetMapped(Window frame, bool mapped);
+
+    // Moves a frame to the top of the stacking order.
+    void Raise(Window frame);
+
+    // Moves a frame right above sibling, or to the bottom if sibling is
+    // None, as reported by ConfigureNotify. Siblings that are not indexed
+    // leave the order as it is.
+    void Restack(Window frame, Window sibling);
+
+    // Sorts frames from the bottom to the top of the stacking order.
+    void SortByStacking(::std::vector<Window> *frames) const;
+
+    bool Contains(Window frame) const { return slots_.Find(frame) != nullptr; }
+
+    // Returns the last known outer rectangle of a frame.
+    bool Get(Window frame, Box *outer) const;
+
+    // Appends all mapped frames intersecting r to out, in no particular order.
+    void Query(const Box &r, ::std::vector<Window> *out) const;
+
+    // Appends the rectangles of all mapped frames to out.
+    void All(::std::vector<Box> *out) const;
+
+    size_t size() const { return slots_.size(); }
+
+private:
+    struct Entry {
+        Window frame;
+        Box rect;
+        uint64_t stacking;
+        bool mapped;
+        // Stamp of the last query that visited this entry, used to report
+        // frames spanning several cells only once.
+        mutable uint64_t visited;
+    };
+
+    struct CellRange {
+        int x0, y0, x1, y1;
+    };
+
+    static CellRange Cells(const Box &r);
+
+    static uint64_t CellKey(int cx, int cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+               static_cast<uint32_t>(cy);
+    }
+
+    void Link(uint32_t slot);
+
+    void Unlink(uint32_t slot);
+
+    ::std::vector<Entry> entries_;
+    ::std::vector<uint32_t> free_;
+    WindowMap<uint32_t> slots_;
+    // Cells are kept when they empty, so frames coming and going reuse
+    // their vectors.
+    ::std::unordered_map<uint64_t, ::std::vector<uint32_t>> cells_;
+    uint64_t stacking_;
+    mutable uint64_t query_;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "ipc.h"
+extern "C" {
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <glog/logging.h>
+
+using ::std::string;
+using ::std::vector;
+
+IpcServer::IpcServer()
+    : listen_fd_(-1) {
+}
+
+IpcServer::~IpcServer() {
+    for (const Connection &c : connections_) {
+        close(c.fd);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(path_.c_str());
+    }
+}
+
+bool IpcServer::Listen(const string &path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LOG(ERROR) << "IPC socket path too long: " << path;
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        PLOG(ERROR) << "socket";
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 16) < 0) {
+        PLOG(ERROR) << "Cannot listen on " << path;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    path_ = path;
+    LOG(INFO) << "Listening for commands on " << path;
+    return true;
+}
+
+void IpcServer::AddPollFds(vector<pollfd> *fds) const {
+    if (listen_fd_ < 0) {
+        return;
+    }
+    fds->push_back(pollfd{listen_fd_, POLLIN, 0});
+    for (const Connection &c : connections_) {
+        fds->push_back(pollfd{c.fd, static_cast<short>(c.output.empty() ? POLLIN : POLLOUT), 0});
+    }
+}
+
+int IpcServer::Dispatch(const vector<pollfd> &fds, const Handler &handler) {
+    int batches = 0;
+    bool accept = false;
+    for (const pollfd &p : fds) {
+        if (p.revents == 0) {
+            continue;
+        }
+        if (p.fd == listen_fd_) {
+            accept = true;
+            continue;
+        }
+        auto c = ::std::find_if(connections_.begin(), connections_.end(),
+                                [&p](const Connection &c) { return c.fd == p.fd; });
+        if (c == connections_.end()) {
+            continue;
+        }
+        const bool open = c->output.empty() ? Read(&*c, handler, &batches) : Write(&*c);
+        if (!open) {
+            close(c->fd);
+            connections_.erase(c);
+        }
+    }
+    if (accept) {
+        Accept();
+    }
+    return batches;
+}
+
+void IpcServer::Accept() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                PLOG(ERROR) << "accept";
+            }
+            return;
+        }
+        connections_.push_back(Connection{fd, string(), string()});
+    }
+}
+
+bool IpcServer::Read(Connection *c, const Handler &handler, int *batches) {
+    char buffer[4096];
+    while (true) {
+        const ssize_t n = read(c->fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            c->input.append(buffer, n);
+            if (c->input.size() > MAX_BATCH_BYTES) {
+                LOG(ERROR) << "IPC batch too large, dropping connection";
+                return false;
+            }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        break;
+    }
+
+    // End of input: the batch is complete.
+    vector<string> commands;
+    std::istringstream in(c->input);
+    string line;
+    while (::std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            commands.push_back(line);
+        }
+    }
+    c->input.clear();
+    for (const string &r : handler(commands)) {
+        c->output += r;
+        c->output += '\n';
+    }
+    ++*batches;
+    return Write(c);
+}
+
+bool IpcServer::Write(Connection *c) {
+    while (!c->output.empty()) {
+        // MSG_NOSIGNAL: a client that went away must not kill us with SIGPIPE.
+        const ssize_t n = send(c->fd, c->output.data(), c->output.size(), MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n < 0 && errno != EPIPE) {
+                PLOG(WARNING) << "Cannot write IPC reply";
+            }
+            return false;
+        }
+        c->output.erase(0, n);
+    }
+    return false;
+}
+
+string IpcSocketPath() {
+    const char *explicit_path = getenv("SIMPLEWM_SOCKET");
+    if (explicit_path != nullptr && *explicit_path) {
+        return explicit_path;
+    }
+    string display = getenv("DISPLAY") != nullptr ? getenv("DISPLAY") : ":0";
+    ::std::replace(display.begin(), display.end(), '/', '_');
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir != nullptr && *runtime_dir) {
+        return string(runtime_dir) + "/simplewm" + display + ".sock";
+    }
+    return "/tmp/simplewm-" + ::std::to_string(getuid()) + display + ".sock";
+}
+
+string JsonEscape(const string &s) {
+    string out;
+    out.reserve(s.size());
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,72 @@
+#ifndef SIMPLEWM_IPC_H
+#define SIMPLEWM_IPC_H
+
+extern "C" {
+#include <poll.h>
+}
+#include <functional>
+#include <string>
+#include <vector>
+
+// Non-blocking Unix domain socket for controlling the window manager.
+//
+// A client connects, writes one command per line and shuts down its write
+// side. Everything it sent is then executed as one batch, one reply line per
+// command is written back and the connection is closed. The server never
+// blocks; a reply the client does not take at once is kept until it does.
+// Its file descriptors are polled by the main loop next to the X connection.
+class IpcServer {
+public:
+    // Executes a batch of commands, returning one reply per command.
+    typedef ::std::function<::std::vector<::std::string>(
+            const ::std::vector<::std::string> &)> Handler;
+
+    IpcServer();
+
+    ~IpcServer();
+
+    // Starts listening on path, replacing a stale socket. Returns false on
+    // failure.
+    bool Listen(const ::std::string &path);
+
+    // Appends the descriptors the server waits on to fds.
+    void AddPollFds(::std::vector<pollfd> *fds) const;
+
+    // Accepts connections and reads from clients whose descriptors are ready
+    // in fds. Batches of clients that finished sending are run through
+    // handler. Returns the number of batches executed.
+    int Dispatch(const ::std::vector<pollfd> &fds, const Handler &handler);
+
+private:
+    // Upper bound on the size of a single batch.
+    static const size_t MAX_BATCH_BYTES = 1 << 20;
+
+    struct Connection {
+        int fd;
+        ::std::string input;
+        // Reply bytes not yet written. Only set once the batch has run.
+        ::std::string output;
+    };
+
+    void Accept();
+
+    // Reads from a connection. Returns false once it should be closed.
+    bool Read(Connection *c, const Handler &handler, int *batches);
+
+    // Writes as much of the pending reply as the socket takes. Returns false
+    // once the connection should be closed.
+    bool Write(Connection *c);
+
+    int listen_fd_;
+    ::std::string path_;
+    ::std::vector<Connection> connections_;
+};
+
+// Returns the socket path for the display named by $DISPLAY. Honours
+// $SIMPLEWM_SOCKET.
+::std::string IpcSocketPath();
+
+// Escapes a string for use inside a JSON string literal.
+::std::string JsonEscape(const ::std::string &s);
+
+#endif
@@ -1,18 +1,68 @@
 #include <cstdlib>
+#include <cstring>
+#include <string>
+extern "C" {
+#include <unistd.h>
+}
 #include <glog/logging.h>
+#include "flight_recorder.h"
 #include "window_manager.h"
 
+using ::std::string;
 using ::std::unique_ptr;
 
+namespace {
+
+// Returns the path of the running executable, or an empty string. Resolved
+// before anything can replace the file: once a rebuild has unlinked it,
+// /proc/self/exe only leads to the old image.
+string ExecutablePath() {
+    char path[4096];
+    const ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (n < 0) {
+        PLOG(WARNING) << "Cannot resolve the executable";
+        return string();
+    }
+    return string(path, n);
+}
+
+}
+
 int main(int argc, char** argv) {
     ::google::InitGoogleLogging(argv[0]);
+    const string executable = ExecutablePath();
+    FlightRecorder::Install(FlightRecorderPath());
 
-    unique_ptr<WindowManager> window_manager(WindowManager::Create());
+    Config config;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--composite") == 0) {
+            config.compositing = true;
+        } else if (strcmp(argv[i], "--focus-follows-mouse") == 0) {
+            config.focus_follows_mouse = true;
+        } else {
+            LOG(ERROR) << "Unknown argument " << argv[i];
+            return EXIT_FAILURE;
+        }
+    }
+
+    unique_ptr<WindowManager> window_manager(WindowManager::Create(config));
     if (!window_manager) {
         LOG(ERROR) << "Failed to initialize window manager";
         return EXIT_FAILURE;
     }
 
     window_manager->Run();
+    if (window_manager->restartRequested()) {
+        // Closes the connection, which leaves the frames to the new process.
+        window_manager.reset();
+        LOG(INFO) << "Restarting";
+        if (!executable.empty()) {
+            execv(executable.c_str(), argv);
+        } else {
+            execvp(argv[0], argv);
+        }
+        PLOG(ERROR) << "Failed to restart";
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "outputs.h"
+extern "C" {
+#include <X11/Xatom.h>
+#include <X11/extensions/Xrandr.h>
+}
+#include <algorithm>
+#include <climits>
+#include <glog/logging.h>
+#include "util.h"
+
+using ::std::vector;
+
+OutputLayout::OutputLayout(Display *display)
+    : display_(display),
+      root_(None),
+      randr_(false),
+      event_base_(0),
+      net_wm_strut_(None),
+      net_wm_strut_partial_(None) {
+}
+
+void OutputLayout::Init(Window root) {
+    root_ = root;
+    net_wm_strut_ = XInternAtom(display_, "_NET_WM_STRUT", false);
+    net_wm_strut_partial_ = XInternAtom(display_, "_NET_WM_STRUT_PARTIAL", false);
+    int error_base, major, minor;
+    if (XRRQueryExtension(display_, &event_base_, &error_base) &&
+        XRRQueryVersion(display_, &major, &minor) &&
+        (major > 1 || (major == 1 && minor >= 5))) {
+        randr_ = true;
+        XRRSelectInput(display_, root_, RRScreenChangeNotifyMask);
+    } else {
+        LOG(WARNING) << "XRandR 1.5 not available, using a single output";
+    }
+    Refresh();
+}
+
+bool OutputLayout::IsScreenChangeEvent(XEvent *e) const {
+    if (!randr_ || e->type != event_base_ + RRScreenChangeNotify) {
+        return false;
+    }
+    XRRUpdateConfiguration(e);
+    return true;
+}
+
+vector<Output> OutputLayout::Refresh() {
+    vector<Output> next = Query();
+    vector<Output> changed;
+    for (const Output &old : outputs_) {
+        bool same = false;
+        for (const Output &o : next) {
+            if (o.name == old.name) {
+                same = o.area.x == old.area.x && o.area.y == old.area.y &&
+                       o.area.width == old.area.width &&
+                       o.area.height == old.area.height;
+                break;
+            }
+        }
+        if (!same) {
+            changed.push_back(old);
+        }
+    }
+    outputs_.swap(next);
+    for (const Output &o : outputs_) {
+        LOG(INFO) << "Output " << o.name << " at "
+                  << Position<int>(o.area.x, o.area.y) << " "
+                  << Size<int>(o.area.width, o.area.height)
+                  << (o.primary ? " (primary)" : "");
+    }
+    return changed;
+}
+
+const Output &OutputLayout::At(int x, int y) const {
+    const Output *nearest = &outputs_.front();
+    long nearest_distance = LONG_MAX;
+    for (const Output &o : outputs_) {
+        if (o.area.Contains(x, y)) {
+            return o;
+        }
+        const long dx = x < o.area.x ? o.area.x - x : (x >= o.area.right() ? x - o.area.right() + 1 : 0);
+        const long dy = y < o.area.y ? o.area.y - y : (y >= o.area.bottom() ? y - o.area.bottom() + 1 : 0);
+        if (dx * dx + dy * dy < nearest_distance) {
+            nearest_distance = dx * dx + dy * dy;
+            nearest = &o;
+        }
+    }
+    return *nearest;
+}
+
+Box OutputLayout::WorkArea(int x, int y) const {
+    const Box &full = At(x, y).area;
+    Box area = full;
+    const int width = DisplayWidth(display_, DefaultScreen(display_));
+    const int height = DisplayHeight(display_, DefaultScreen(display_));
+    for (const Strut &s : struts_) {
+        const long *v = s.values;
+        // Each reservation applies to the outputs it overlaps, cutting them
+        // back to where it starts.
+        const Box left{0, int(v[4]), int(v[0]), int(v[5] - v[4] + 1)};
+        if (!left.empty() && left.Intersects(area)) {
+            const int edge = ::std::max(area.x, left.right());
+            area.width -= edge - area.x;
+            area.x = edge;
+        }
+        const Box right{width - int(v[1]), int(v[6]), int(v[1]), int(v[7] - v[6] + 1)};
+        if (!right.empty() && right.Intersects(area)) {
+            area.width = ::std::min(area.right(), right.x) - area.x;
+        }
+        const Box top{int(v[8]), 0, int(v[9] - v[8] + 1), int(v[2])};
+        if (!top.empty() && top.Intersects(area)) {
+            const int edge = ::std::max(area.y, top.bottom());
+            area.height -= edge - area.y;
+            area.y = edge;
+        }
+        const Box bottom{int(v[10]), height - int(v[3]), int(v[11] - v[10] + 1), int(v[3])};
+        if (!bottom.empty() && bottom.Intersects(area)) {
+            area.height = ::std::min(area.bottom(), bottom.y) - area.y;
+        }
+    }
+    // Struts covering a whole output leave it to the frames.
+    return area.empty() ? full : area;
+}
+
+void OutputLayout::UpdateStrut(Window w) {
+    RemoveStrut(w);
+    Strut strut;
+    strut.owner = w;
+    // Prefers the partial struts; plain ones span their whole edge.
+    for (Atom property : {net_wm_strut_partial_, net_wm_strut_}) {
+        Atom type;
+        int format;
+        unsigned long n, bytes_after;
+        unsigned char *data = nullptr;
+        if (XGetWindowProperty(display_, w, property, 0, 12, false, XA_CARDINAL,
+                               &type, &format, &n, &bytes_after, &data) != Success ||
+            data == nullptr) {
+            continue;
+        }
+        const long *values = reinterpret_cast<const long *>(data);
+        const unsigned long fields = property == net_wm_strut_partial_ ? 12 : 4;
+        const bool valid = format == 32 && n >= fields;
+        if (valid) {
+            ::std::fill(strut.values, strut.values + 12, 0);
+            ::std::copy(values, values + fields, strut.values);
+            if (fields == 4) {
+                for (int i = 4; i < 12; i += 2) {
+                    strut.values[i + 1] = INT_MAX / 2;
+                }
+            }
+        }
+        XFree(data);
+        if (!valid) {
+            continue;
+        }
+        if (strut.values[0] > 0 || strut.values[1] > 0 || strut.values[2] > 0 || strut.values[3] > 0) {
+            struts_.push_back(strut);
+            LOG(INFO) << "Window " << w << " reserves screen edges " << strut.values[0] << " "
+                      << strut.values[1] << " " << strut.values[2] << " " << strut.values[3];
+        }
+        return;
+    }
+}
+
+void OutputLayout::RemoveStrut(Window w) {
+    struts_.erase(::std::remove_if(struts_.begin(), struts_.end(),
+                                   [w](const Strut &s) { return s.owner == w; }),
+                  struts_.end());
+}
+
+const Output &OutputLayout::Primary() const {
+    for (const Output &o : outputs_) {
+        if (o.primary) {
+            return o;
+        }
+    }
+    return outputs_.front();
+}
+
+const Output *OutputLayout::Find(Atom name) const {
+    for (const Output &o : outputs_) {
+        if (o.name == name) {
+            return &o;
+        }
+    }
+    return nullptr;
+}
+
+vector<Output> OutputLayout::Query() const {
+    vector<Output> outputs;
+    if (randr_) {
+        int n = 0;
+        XRRMonitorInfo *monitors = XRRGetMonitors(display_, root_, true, &n);
+        for (int i = 0; i < n; ++i) {
+            Output o;
+            o.name = monitors[i].name;
+            o.area.x = monitors[i].x;
+            o.area.y = monitors[i].y;
+            o.area.width = monitors[i].width;
+            o.area.height = monitors[i].height;
+            o.primary = monitors[i].primary;
+            outputs.push_back(o);
+        }
+        if (monitors != nullptr) {
+            XRRFreeMonitors(monitors);
+        }
+    }
+    if (outputs.empty()) {
+        Output o;
+        o.name = None;
+        o.area.x = 0;
+        o.area.y = 0;
+        o.area.width = DisplayWidth(display_, DefaultScreen(display_));
+        o.area.height = DisplayHeight(display_, DefaultScreen(display_));
+        o.primary = true;
+        outputs.push_back(o);
+    }
+    return outputs;
+}
@@ -0,0 +1,84 @@
+#ifndef SIMPLEWM_OUTPUTS_H
+#define SIMPLEWM_OUTPUTS_H
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <vector>
+#include "geometry_index.h"
+
+// A monitor as reported by XRandR.
+struct Output {
+    Atom name;
+    Box area;
+    bool primary;
+};
+
+// Tracks the XRandR monitor layout of the root window and the screen edges
+// reserved by docks through _NET_WM_STRUT(_PARTIAL).
+//
+// Without XRandR 1.5 the whole root window is treated as a single output.
+class OutputLayout {
+public:
+    explicit OutputLayout(Display *display);
+
+    // Queries the extension, selects screen change notifications on root and
+    // reads the initial layout.
+    void Init(Window root);
+
+    // Whether e is an RRScreenChangeNotify event. Also lets Xlib update its
+    // cached screen size.
+    bool IsScreenChangeEvent(XEvent *e) const;
+
+    // Re-reads the layout. Returns the outputs of the previous layout that
+    // were removed or changed geometry.
+    ::std::vector<Output> Refresh();
+
+    // Returns the output containing a point, or the nearest one.
+    const Output &At(int x, int y) const;
+
+    // Returns the primary output, or the first one if none is primary.
+    const Output &Primary() const;
+
+    // Returns the output with the given name, or nullptr.
+    const Output *Find(Atom name) const;
+
+    // Returns the area available to frames on the output containing a point:
+    // the output minus the struts that reach into it.
+    Box WorkArea(int x, int y) const;
+
+    // Whether a property change may alter the struts of a window.
+    bool IsStrutProperty(Atom atom) const {
+        return atom == net_wm_strut_ || atom == net_wm_strut_partial_;
+    }
+
+    // Reads the struts of a client, replacing any it had before.
+    void UpdateStrut(Window w);
+
+    // Forgets the struts of a client that is no longer managed.
+    void RemoveStrut(Window w);
+
+    const ::std::vector<Output> &outputs() const { return outputs_; }
+
+private:
+    // The _NET_WM_STRUT_PARTIAL fields: the width reserved at the left,
+    // right, top and bottom edges of the screen, then the first and last
+    // row or column of each reservation along its edge.
+    struct Strut {
+        Window owner;
+        long values[12];
+    };
+
+    ::std::vector<Output> Query() const;
+
+    Display *display_;
+    Window root_;
+    bool randr_;
+    int event_base_;
+    Atom net_wm_strut_;
+    Atom net_wm_strut_partial_;
+    ::std::vector<Output> outputs_;
+    ::std::vector<Strut> struts_;
+};
+
+#endif
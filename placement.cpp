@@ -0,0 +1,145 @@
+#include "placement.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+using ::std::max;
+using ::std::min;
+using ::std::vector;
+
+namespace {
+
+// Upper bound on the number of grid cells, which bounds the cost of a
+// placement independently of the screen resolution.
+const int MAX_CELLS = 16384;
+// Placement granularity on small screens.
+const int MIN_CELL_SIZE = 8;
+
+}
+
+Position<int> PlaceLeastOverlap(
+        const Box &area,
+        int width,
+        int height,
+        const vector<Box> &occupied) {
+    if (area.width <= 0 || area.height <= 0 ||
+        width >= area.width || height >= area.height) {
+        return Position<int>(area.x, area.y);
+    }
+
+    const int cell = max(MIN_CELL_SIZE, static_cast<int>(std::ceil(
+            std::sqrt(static_cast<double>(area.width) * area.height / MAX_CELLS))));
+    const int cols = (area.width + cell - 1) / cell;
+    const int rows = (area.height + cell - 1) / cell;
+    const int stride = cols + 1;
+
+    // 1. Scatter each rectangle, widened to whole cells, into a 2D
+    //    difference array. Row and column 0 stay zero, so that cell (x, y)
+    //    lives at sat[(y + 1) * stride + x + 1].
+    vector<int32_t> sat(static_cast<size_t>(stride) * (rows + 1), 0);
+    auto scatter = [&](int x, int y, int32_t v) {
+        if (x <= cols && y <= rows) {
+            sat[y * stride + x] += v;
+        }
+    };
+    for (const Box &r : occupied) {
+        const int x0 = max(0, (r.x - area.x) / cell);
+        const int y0 = max(0, (r.y - area.y) / cell);
+        const int x1 = min(cols, (r.right() - area.x + cell - 1) / cell);
+        const int y1 = min(rows, (r.bottom() - area.y + cell - 1) / cell);
+        if (r.right() <= area.x || r.bottom() <= area.y || x0 >= x1 || y0 >= y1) {
+            continue;
+        }
+        scatter(x0 + 1, y0 + 1, 1);
+        scatter(x1 + 1, y0 + 1, -1);
+        scatter(x0 + 1, y1 + 1, -1);
+        scatter(x1 + 1, y1 + 1, 1);
+    }
+
+    // 2. Integrating once yields the occupancy of each cell, integrating
+    //    again yields the summed-area table of occupancy.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int y = 1; y <= rows; ++y) {
+            int32_t row = 0;
+            for (int x = 1; x <= cols; ++x) {
+                row += sat[y * stride + x];
+                sat[y * stride + x] = row + sat[(y - 1) * stride + x];
+            }
+        }
+    }
+
+    // 3. Score every position at which the frame fits inside the area.
+    const int w = (width + cell - 1) / cell;
+    const int h = (height + cell - 1) / cell;
+    const int max_x = (area.width - width) / cell;
+    const int max_y = (area.height - height) / cell;
+    int32_t best = INT32_MAX;
+    int best_x = 0, best_y = 0;
+    for (int y = 0; y <= max_y && best > 0; ++y) {
+        for (int x = 0; x <= max_x; ++x) {
+            const int32_t score =
+                    sat[(y + h) * stride + x + w] - sat[y * stride + x + w] -
+                    sat[(y + h) * stride + x] + sat[y * stride + x];
+            if (score < best) {
+                best = score;
+                best_x = x;
+                best_y = y;
+                if (best == 0) {
+                    break;
+                }
+            }
+        }
+    }
+    return Position<int>(area.x + best_x * cell, area.y + best_y * cell);
+}
+
+vector<Box> GridLayout(
+        const Box &area,
+        const vector<Box> &frames,
+        int gap) {
+    const int n = static_cast<int>(frames.size());
+    // Scale of frame i in a cell_width x cell_height cell.
+    auto scale = [&frames](int i, int cell_width, int cell_height) {
+        const Box &f = frames[i];
+        if (f.empty() || cell_width <= 0 || cell_height <= 0)
+            return 0.0;
+        return min(1.0, min(static_cast<double>(cell_width) / f.width,
+                            static_cast<double>(cell_height) / f.height));
+    };
+
+    int best_cols = 1;
+    double best_area = -1;
+    for (int cols = 1; cols <= n; ++cols) {
+        const int rows = (n + cols - 1) / cols;
+        const int cell_width = (area.width - gap * (cols + 1)) / cols;
+        const int cell_height = (area.height - gap * (rows + 1)) / rows;
+        double shown = 0;
+        for (int i = 0; i < n; ++i) {
+            const double s = scale(i, cell_width, cell_height);
+            shown += s * s * frames[i].width * frames[i].height;
+        }
+        if (shown > best_area) {
+            best_area = shown;
+            best_cols = cols;
+        }
+    }
+
+    vector<Box> thumbnails;
+    thumbnails.reserve(n);
+    const int cols = best_cols;
+    const int rows = max(1, (n + cols - 1) / cols);
+    const int cell_width = (area.width - gap * (cols + 1)) / cols;
+    const int cell_height = (area.height - gap * (rows + 1)) / rows;
+    for (int i = 0; i < n; ++i) {
+        const double s = scale(i, cell_width, cell_height);
+        const int width = max(1, static_cast<int>(frames[i].width * s));
+        const int height = max(1, static_cast<int>(frames[i].height * s));
+        const int cell_x = area.x + gap + (i % cols) * (cell_width + gap);
+        const int cell_y = area.y + gap + (i / cols) * (cell_height + gap);
+        thumbnails.push_back(Box{cell_x + (cell_width - width) / 2,
+                                 cell_y + (cell_height - height) / 2,
+                                 width, height});
+    }
+    return thumbnails;
+}
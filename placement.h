@@ -0,0 +1,32 @@
+#ifndef SIMPLEWM_PLACEMENT_H
+#define SIMPLEWM_PLACEMENT_H
+
+#include <vector>
+#include "geometry_index.h"
+#include "util.h"
+
+// Returns the top-left corner at which a width x height frame overlaps the
+// occupied rectangles the least, keeping it inside area where it fits.
+//
+// The area is rasterised into a coarse grid whose occupancy counts are
+// accumulated into a summed-area table, after which every candidate
+// position is scored in constant time. The cost is linear in the number of
+// occupied rectangles plus the (bounded) number of grid cells. Ties are
+// broken towards the top, then the left.
+Position<int> PlaceLeastOverlap(
+        const Box &area,
+        int width,
+        int height,
+        const ::std::vector<Box> &occupied);
+
+// Lays thumbnails of the given frames out as a grid in area, in the order
+// given, leaving gap pixels around every cell. Each thumbnail keeps the
+// aspect ratio of its frame, is never larger than the frame and is centered
+// in its cell. The number of columns is the one that shows the most of the
+// frames.
+::std::vector<Box> GridLayout(
+        const Box &area,
+        const ::std::vector<Box> &frames,
+        int gap);
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef SIMPLEWM_POOL_H
+#define SIMPLEWM_POOL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Refers to a record in a Pool. A handle whose record was freed is stale
+// and no longer resolves, even after the slot has been reused.
+struct Handle {
+    uint32_t index = 0;
+    // 0 for the null handle; live records always have a generation > 0.
+    uint32_t generation = 0;
+
+    explicit operator bool() const { return generation != 0; }
+
+    bool operator==(const Handle &o) const {
+        return index == o.index && generation == o.generation;
+    }
+    bool operator!=(const Handle &o) const { return !(*this == o); }
+};
+
+// Slab allocator for fixed-size records with generation-checked handles.
+//
+// Records are allocated in chunks of CHUNK_SIZE and never move, so pointers
+// stay valid until the record is freed. Freed slots go onto a free list and
+// are reused before a new chunk is allocated, so a steady number of live
+// records allocates nothing.
+template <typename T>
+class Pool {
+public:
+    static const uint32_t CHUNK_SIZE = 64;
+
+    Pool() : free_(NIL), capacity_(0), size_(0) {}
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    // Returns a handle to a new value-initialized record.
+    Handle Allocate() {
+        if (free_ == NIL) {
+            chunks_.emplace_back(new Slot[CHUNK_SIZE]);
+            // Thread the new slots onto the free list, lowest index first.
+            for (uint32_t i = CHUNK_SIZE; i-- > 0;) {
+                Slot &slot = chunks_.back()[i];
+                slot.generation = 0;
+                slot.live = false;
+                slot.next_free = free_;
+                free_ = capacity_ + i;
+            }
+            capacity_ += CHUNK_SIZE;
+        }
+        const uint32_t index = free_;
+        Slot &slot = At(index);
+        free_ = slot.next_free;
+        slot.record = T();
+        slot.live = true;
+        if (++slot.generation == 0)
+            slot.generation = 1;
+        ++size_;
+        Handle h;
+        h.index = index;
+        h.generation = slot.generation;
+        return h;
+    }
+
+    // Frees a record. Stale handles are ignored.
+    void Free(Handle h) {
+        if (Get(h) == nullptr)
+            return;
+        Slot &slot = At(h.index);
+        slot.live = false;
+        slot.next_free = free_;
+        free_ = h.index;
+        --size_;
+    }
+
+    // Returns the record a handle refers to, or nullptr if it is stale.
+    T *Get(Handle h) {
+        if (!h || h.index >= capacity_)
+            return nullptr;
+        Slot &slot = At(h.index);
+        return slot.live && slot.generation == h.generation ? &slot.record : nullptr;
+    }
+
+    const T *Get(Handle h) const {
+        return const_cast<Pool *>(this)->Get(h);
+    }
+
+    // Calls f(handle, record) for every live record, in slot order.
+    template <typename F>
+    void ForEach(F f) {
+        for (uint32_t index = 0; index < capacity_; ++index) {
+            Slot &slot = At(index);
+            if (!slot.live)
+                continue;
+            Handle h;
+            h.index = index;
+            h.generation = slot.generation;
+            f(h, slot.record);
+        }
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    static const uint32_t NIL = UINT32_MAX;
+
+    struct Slot {
+        T record;
+        uint32_t generation;
+        uint32_t next_free;
+        bool live;
+    };
+
+    Slot &At(uint32_t index) {
+        return chunks_[index / CHUNK_SIZE][index % CHUNK_SIZE];
+    }
+
+    ::std::vector<::std::unique_ptr<Slot[]>> chunks_;
+    uint32_t free_;
+    uint32_t capacity_;
+    size_t size_;
+};
+
+#endif
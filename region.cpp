@@ -0,0 +1,349 @@
+#include "region.h"
+#include <algorithm>
+#include <climits>
+
+using ::std::max;
+using ::std::min;
+
+namespace {
+
+// Returns the end of the band starting at r.
+const Box *BandEnd(const Box *r, const Box *end) {
+    const int y = r->y;
+    while (r != end && r->y == y) {
+        ++r;
+    }
+    return r;
+}
+
+}
+
+BoxRegion::BoxRegion(const Box &r)
+    : BoxRegion() {
+    if (!r.empty()) {
+        inline_[0] = r;
+        size_ = 1;
+        extents_ = r;
+    }
+}
+
+BoxRegion::BoxRegion(const BoxRegion &o)
+    : BoxRegion() {
+    *this = o;
+}
+
+BoxRegion &BoxRegion::operator=(const BoxRegion &o) {
+    if (this != &o) {
+        size_ = 0;
+        Reserve(o.size_);
+        ::std::copy(o.begin(), o.end(), data());
+        size_ = o.size_;
+        extents_ = o.extents_;
+    }
+    return *this;
+}
+
+BoxRegion::BoxRegion(BoxRegion &&o) noexcept
+    : BoxRegion() {
+    *this = ::std::move(o);
+}
+
+BoxRegion &BoxRegion::operator=(BoxRegion &&o) noexcept {
+    if (this == &o) {
+        return *this;
+    }
+    if (o.heap_) {
+        heap_ = ::std::move(o.heap_);
+        capacity_ = o.capacity_;
+    } else {
+        heap_.reset();
+        capacity_ = INLINE_RECTS;
+        ::std::copy(o.inline_, o.inline_ + o.size_, inline_);
+    }
+    size_ = o.size_;
+    extents_ = o.extents_;
+    o.capacity_ = INLINE_RECTS;
+    o.Clear();
+    return *this;
+}
+
+void BoxRegion::Reserve(uint32_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    ::std::unique_ptr<Box[]> heap(new Box[capacity]);
+    ::std::copy(begin(), end(), heap.get());
+    heap_ = ::std::move(heap);
+    capacity_ = capacity;
+}
+
+void BoxRegion::Clear() {
+    size_ = 0;
+    extents_ = Box{0, 0, 0, 0};
+}
+
+bool BoxRegion::Contains(int x, int y) const {
+    if (!extents_.Contains(x, y)) {
+        return false;
+    }
+    for (const Box &r : *this) {
+        if (r.y > y) {
+            break;
+        }
+        if (r.Contains(x, y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BoxRegion::Intersects(const Box &r) const {
+    // Rect::Intersects counts rectangles without area lying inside another.
+    if (r.empty() || !extents_.Intersects(r)) {
+        return false;
+    }
+    for (const Box &b : *this) {
+        if (b.y >= r.bottom()) {
+            break;
+        }
+        if (b.Intersects(r)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BoxRegion::Union(const BoxRegion &o) {
+    if (o.empty() || this == &o) {
+        return;
+    }
+    if (empty() || (o.size_ == 1 && o.extents_.Contains(extents_))) {
+        *this = o;
+        return;
+    }
+    if (size_ == 1 && extents_.Contains(o.extents_)) {
+        return;
+    }
+    BoxRegion result;
+    result.Reserve(2 * (size_ + o.size_));
+    result.Combine(*this, o, UNION);
+    *this = ::std::move(result);
+}
+
+void BoxRegion::Union(const Box &r) {
+    // Rectangles added from top to bottom, as when rows are damaged one
+    // after the other, become a new band without a sweep.
+    if (!r.empty() && !empty() && r.y >= extents_.bottom()) {
+        Box &last = data()[size_ - 1];
+        const bool alone = size_ == 1 || data()[size_ - 2].y != last.y;
+        if (alone && last.bottom() == r.y && last.x == r.x && last.width == r.width) {
+            last.height += r.height;
+        } else {
+            Append(r);
+        }
+        extents_ = extents_.Bound(r);
+        return;
+    }
+    Union(BoxRegion(r));
+}
+
+void BoxRegion::Intersect(const BoxRegion &o) {
+    if (this == &o) {
+        return;
+    }
+    if (empty() || o.empty() || !extents_.Intersects(o.extents_)) {
+        Clear();
+        return;
+    }
+    if (o.size_ == 1 && o.extents_.Contains(extents_)) {
+        return;
+    }
+    if (size_ == 1 && extents_.Contains(o.extents_)) {
+        *this = o;
+        return;
+    }
+    BoxRegion result;
+    result.Reserve(2 * (size_ + o.size_));
+    result.Combine(*this, o, INTERSECT);
+    *this = ::std::move(result);
+}
+
+void BoxRegion::Intersect(const Box &r) {
+    Intersect(BoxRegion(r));
+}
+
+void BoxRegion::Subtract(const BoxRegion &o) {
+    if (this == &o) {
+        Clear();
+        return;
+    }
+    if (empty() || o.empty() || !extents_.Intersects(o.extents_)) {
+        return;
+    }
+    if (o.size_ == 1 && o.extents_.Contains(extents_)) {
+        Clear();
+        return;
+    }
+    BoxRegion result;
+    result.Reserve(2 * (size_ + o.size_));
+    result.Combine(*this, o, SUBTRACT);
+    *this = ::std::move(result);
+}
+
+void BoxRegion::Subtract(const Box &r) {
+    Subtract(BoxRegion(r));
+}
+
+void BoxRegion::Translate(int dx, int dy) {
+    for (Box *r = data(); r != data() + size_; ++r) {
+        *r = r->Translate(dx, dy);
+    }
+    if (size_ > 0) {
+        extents_ = extents_.Translate(dx, dy);
+    }
+}
+
+bool BoxRegion::operator==(const BoxRegion &o) const {
+    return size_ == o.size_ && ::std::equal(begin(), end(), o.begin());
+}
+
+void BoxRegion::Combine(const BoxRegion &a, const BoxRegion &b, Op op) {
+    Clear();
+    const Box *ra = a.begin(), *ea = a.end();
+    const Box *rb = b.begin(), *eb = b.end();
+    uint32_t previous = UINT32_MAX;
+    // Everything above y has been swept.
+    int y = INT_MIN;
+    while (ra != ea || rb != eb) {
+        if ((op == INTERSECT && (ra == ea || rb == eb)) || (op == SUBTRACT && ra == ea)) {
+            break;
+        }
+        const Box *na = ra != ea ? BandEnd(ra, ea) : ea;
+        const Box *nb = rb != eb ? BandEnd(rb, eb) : eb;
+        const int a_top = ra != ea ? max(ra->y, y) : INT_MAX;
+        const int b_top = rb != eb ? max(rb->y, y) : INT_MAX;
+        const int a_bottom = ra != ea ? ra->bottom() : INT_MAX;
+        const int b_bottom = rb != eb ? rb->bottom() : INT_MAX;
+
+        // The next band of the result ends where either operand's band
+        // starts or ends.
+        const int top = min(a_top, b_top);
+        const bool in_a = a_top == top;
+        const bool in_b = b_top == top;
+        const int bottom = min(in_a ? a_bottom : a_top, in_b ? b_bottom : b_top);
+        AppendBand(top, bottom, ra, in_a ? na : ra, rb, in_b ? nb : rb, op, &previous);
+
+        y = bottom;
+        if (in_a && a_bottom == bottom) {
+            ra = na;
+        }
+        if (in_b && b_bottom == bottom) {
+            rb = nb;
+        }
+    }
+    UpdateExtents();
+}
+
+void BoxRegion::AppendBand(int top, int bottom, const Box *a, const Box *a_end,
+                        const Box *b, const Box *b_end, Op op, uint32_t *previous) {
+    const uint32_t start = size_;
+    const int height = bottom - top;
+    auto emit = [this, top, height](int x1, int x2) {
+        Append(Box{x1, top, x2 - x1, height});
+    };
+
+    switch (op) {
+        case UNION: {
+            int x1 = 0, x2 = INT_MIN;
+            while (a != a_end || b != b_end) {
+                const Box *next;
+                if (b == b_end || (a != a_end && a->x <= b->x)) {
+                    next = a++;
+                } else {
+                    next = b++;
+                }
+                if (next->x > x2) {
+                    if (x2 != INT_MIN) {
+                        emit(x1, x2);
+                    }
+                    x1 = next->x;
+                    x2 = next->right();
+                } else {
+                    x2 = max(x2, next->right());
+                }
+            }
+            if (x2 != INT_MIN) {
+                emit(x1, x2);
+            }
+            break;
+        }
+        case INTERSECT:
+            while (a != a_end && b != b_end) {
+                const int x1 = max(a->x, b->x);
+                const int x2 = min(a->right(), b->right());
+                if (x1 < x2) {
+                    emit(x1, x2);
+                }
+                if (a->right() < b->right()) {
+                    ++a;
+                } else {
+                    ++b;
+                }
+            }
+            break;
+        case SUBTRACT:
+            for (; a != a_end; ++a) {
+                int x = a->x;
+                while (b != b_end && b->right() <= x) {
+                    ++b;
+                }
+                // b may also cut into the next span of a, so it is kept.
+                for (const Box *c = b; c != b_end && c->x < a->right(); ++c) {
+                    if (c->x > x) {
+                        emit(x, c->x);
+                    }
+                    x = max(x, c->right());
+                }
+                if (x < a->right()) {
+                    emit(x, a->right());
+                }
+            }
+            break;
+    }
+
+    if (size_ == start) {
+        return;
+    }
+    Box *rects = data();
+    const uint32_t count = size_ - start;
+    if (*previous != UINT32_MAX && start - *previous == count &&
+        rects[*previous].bottom() == top) {
+        bool same = true;
+        for (uint32_t i = 0; i < count && same; ++i) {
+            same = rects[*previous + i].x == rects[start + i].x &&
+                   rects[*previous + i].width == rects[start + i].width;
+        }
+        if (same) {
+            for (uint32_t i = *previous; i < start; ++i) {
+                rects[i].height += height;
+            }
+            size_ = start;
+            return;
+        }
+    }
+    *previous = start;
+}
+
+void BoxRegion::UpdateExtents() {
+    if (size_ == 0) {
+        extents_ = Box{0, 0, 0, 0};
+        return;
+    }
+    const Box *rects = data();
+    int left = INT_MAX, right = INT_MIN;
+    for (uint32_t i = 0; i < size_; ++i) {
+        left = min(left, rects[i].x);
+        right = max(right, rects[i].right());
+    }
+    extents_ = Box::FromEdges(left, rects[0].y, right, rects[size_ - 1].bottom());
+}
@@ -0,0 +1,94 @@
+#ifndef SIMPLEWM_REGION_H
+#define SIMPLEWM_REGION_H
+
+#include <cstdint>
+#include <memory>
+#include "geometry_index.h"
+
+// A set of pixels stored as non-overlapping rectangles, like X regions.
+//
+// The rectangles are banded: sorted by y and then x, with all rectangles of
+// a band sharing y and height, horizontally touching rectangles of a band
+// merged and vertically touching bands with the same spans coalesced. Every
+// region therefore has exactly one representation, and the set operations
+// are a single sweep over the bands of both operands.
+//
+// Up to INLINE_RECTS rectangles are stored in the object itself, so typical
+// damage and occlusion regions never allocate.
+class BoxRegion {
+public:
+    static const uint32_t INLINE_RECTS = 8;
+
+    BoxRegion() : size_(0), capacity_(INLINE_RECTS), extents_{0, 0, 0, 0} {}
+
+    explicit BoxRegion(const Box &r);
+
+    BoxRegion(const BoxRegion &o);
+    BoxRegion &operator=(const BoxRegion &o);
+    BoxRegion(BoxRegion &&o) noexcept;
+    BoxRegion &operator=(BoxRegion &&o) noexcept;
+
+    bool empty() const { return size_ == 0; }
+
+    // Number of rectangles.
+    size_t size() const { return size_; }
+
+    const Box *begin() const { return data(); }
+    const Box *end() const { return data() + size_; }
+
+    // Smallest rectangle covering the region; empty for an empty region.
+    const Box &extents() const { return extents_; }
+
+    void Clear();
+
+    bool Contains(int x, int y) const;
+
+    bool Intersects(const Box &r) const;
+
+    void Union(const BoxRegion &o);
+    void Union(const Box &r);
+
+    void Intersect(const BoxRegion &o);
+    void Intersect(const Box &r);
+
+    void Subtract(const BoxRegion &o);
+    void Subtract(const Box &r);
+
+    void Translate(int dx, int dy);
+
+    bool operator==(const BoxRegion &o) const;
+    bool operator!=(const BoxRegion &o) const { return !(*this == o); }
+
+private:
+    enum Op { UNION, INTERSECT, SUBTRACT };
+
+    Box *data() { return heap_ ? heap_.get() : inline_; }
+    const Box *data() const { return heap_ ? heap_.get() : inline_; }
+
+    void Reserve(uint32_t capacity);
+
+    void Append(const Box &r) {
+        if (size_ == capacity_)
+            Reserve(capacity_ * 2);
+        data()[size_++] = r;
+    }
+
+    // Sets *this to a op b. Neither operand may be *this.
+    void Combine(const BoxRegion &a, const BoxRegion &b, Op op);
+
+    // Appends the band [top, bottom) with the spans a op b, where a and b
+    // are the rectangles of one band of each operand, and merges it into the
+    // band starting at *previous if both have the same spans.
+    void AppendBand(int top, int bottom, const Box *a, const Box *a_end,
+                    const Box *b, const Box *b_end, Op op, uint32_t *previous);
+
+    void UpdateExtents();
+
+    uint32_t size_;
+    uint32_t capacity_;
+    Box extents_;
+    ::std::unique_ptr<Box[]> heap_;
+    Box inline_[INLINE_RECTS];
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "region.h"
+
+using ::std::vector;
+
+namespace {
+
+// Keeps the compiler from optimizing a benchmarked result away.
+volatile size_t sink;
+
+template <typename F>
+void Run(const char *name, int iterations, F f) {
+    const auto start = ::std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        f(i);
+    }
+    const double ns = ::std::chrono::duration<double, ::std::nano>(
+            ::std::chrono::steady_clock::now() - start).count();
+    printf("%-40s %10.1f ns/op\n", name, ns / iterations);
+}
+
+// Random window-sized rectangles on a 2560x1440 screen.
+vector<Box> Windows(::std::mt19937 *rng, int n) {
+    ::std::uniform_int_distribution<int> x(0, 2000), y(0, 1000);
+    ::std::uniform_int_distribution<int> w(200, 900), h(150, 700);
+    vector<Box> boxes;
+    for (int i = 0; i < n; ++i) {
+        boxes.push_back(Box{x(*rng), y(*rng), w(*rng), h(*rng)});
+    }
+    return boxes;
+}
+
+// Random damage: small rectangles such as repainted widgets and text.
+vector<Box> Damage(::std::mt19937 *rng, int n) {
+    ::std::uniform_int_distribution<int> x(0, 2500), y(0, 1400);
+    ::std::uniform_int_distribution<int> w(4, 120), h(4, 40);
+    vector<Box> boxes;
+    for (int i = 0; i < n; ++i) {
+        boxes.push_back(Box{x(*rng), y(*rng), w(*rng), h(*rng)});
+    }
+    return boxes;
+}
+
+}
+
+// Microbenchmarks of the region operations on workloads shaped like
+// compositor damage and window occlusion.
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? atoi(argv[1]) : 200000;
+    ::std::mt19937 rng(42);
+    const Box screen{0, 0, 2560, 1440};
+    const vector<Box> windows = Windows(&rng, 8);
+    const vector<Box> damage = Damage(&rng, 1024);
+
+    Run("union of 4 damage rects", iterations, [&](int i) {
+        BoxRegion r;
+        for (int k = 0; k < 4; ++k) {
+            r.Union(damage[(i * 4 + k) % damage.size()]);
+        }
+        sink = r.size();
+    });
+    Run("union of 16 damage rects", iterations / 4, [&](int i) {
+        BoxRegion r;
+        for (int k = 0; k < 16; ++k) {
+            r.Union(damage[(i * 16 + k) % damage.size()]);
+        }
+        sink = r.size();
+    });
+    Run("union of touching rows (coalescing)", iterations, [&](int) {
+        BoxRegion r;
+        for (int k = 0; k < 16; ++k) {
+            r.Union(Box{100, 100 + k * 10, 400, 10});
+        }
+        sink = r.size();
+    });
+
+    BoxRegion accumulated;
+    for (int k = 0; k < 16; ++k) {
+        accumulated.Union(damage[k]);
+    }
+    Run("intersect 16-rect damage with screen", iterations, [&](int) {
+        BoxRegion r = accumulated;
+        r.Intersect(screen);
+        sink = r.size();
+    });
+    Run("intersect 16-rect damage with window", iterations, [&](int i) {
+        BoxRegion r = accumulated;
+        r.Intersect(windows[i % windows.size()]);
+        sink = r.size();
+    });
+
+    Run("screen minus 8 windows (occlusion)", iterations / 4, [&](int) {
+        BoxRegion r(screen);
+        for (const Box &w : windows) {
+            r.Subtract(w);
+        }
+        sink = r.size();
+    });
+    Run("window minus damage rect", iterations, [&](int i) {
+        BoxRegion r(windows[i % windows.size()]);
+        r.Subtract(damage[i % damage.size()]);
+        sink = r.size();
+    });
+
+    BoxRegion visible(screen);
+    for (const Box &w : windows) {
+        visible.Subtract(w);
+    }
+    printf("occlusion region has %zu rects\n", visible.size());
+    Run("hit test against occlusion region", iterations, [&](int i) {
+        sink = visible.Contains(i % screen.width, (i * 7) % screen.height);
+    });
+    return EXIT_SUCCESS;
+}
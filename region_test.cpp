@@ -0,0 +1,196 @@
+#include "region.h"
+#include <bitset>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <glog/logging.h>
+
+namespace {
+
+// Regions are checked pixel by pixel on a small grid; rectangles stick out
+// of it on every side.
+const int GRID = 48;
+const int MARGIN = 8;
+const int SIDE = GRID + 2 * MARGIN;
+
+typedef ::std::bitset<SIDE * SIDE> Pixels;
+
+size_t Bit(int x, int y) {
+    return static_cast<size_t>(y + MARGIN) * SIDE + (x + MARGIN);
+}
+
+Pixels Rasterize(const Box &r) {
+    Pixels p;
+    for (int y = r.y; y < r.bottom(); ++y) {
+        for (int x = r.x; x < r.right(); ++x) {
+            p.set(Bit(x, y));
+        }
+    }
+    return p;
+}
+
+// Returns a rectangle of up to 24 x 24 pixels, possibly empty, within the
+// margins of the grid.
+Box RandomBox(::std::mt19937 *rng) {
+    ::std::uniform_int_distribution<int> size(0, 24);
+    const int width = size(*rng), height = size(*rng);
+    ::std::uniform_int_distribution<int> x(-MARGIN, GRID + MARGIN - width);
+    ::std::uniform_int_distribution<int> y(-MARGIN, GRID + MARGIN - height);
+    return Box{x(*rng), y(*rng), width, height};
+}
+
+// Checks that a region is in its canonical banded form and covers exactly
+// the given pixels.
+void Verify(const BoxRegion &region, const Pixels &expected) {
+    Pixels covered;
+    Box extents{0, 0, 0, 0};
+    const Box *band = region.begin();
+    const Box *previous_band = nullptr;
+    const Box *previous_band_end = nullptr;
+    while (band != region.end()) {
+        const Box *band_end = band;
+        while (band_end != region.end() && band_end->y == band->y) {
+            CHECK_EQ(band_end->height, band->height) << "Ragged band at y " << band->y;
+            CHECK(!band_end->empty());
+            // Spans are sorted and neither overlap nor touch.
+            if (band_end != band) {
+                CHECK_LT((band_end - 1)->right(), band_end->x);
+            }
+            ++band_end;
+        }
+        if (previous_band != nullptr) {
+            CHECK_LE(previous_band->bottom(), band->y);
+            // Touching bands with the same spans are coalesced.
+            if (previous_band->bottom() == band->y &&
+                previous_band_end - previous_band == band_end - band) {
+                bool same = true;
+                for (const Box *a = previous_band, *b = band; a != previous_band_end; ++a, ++b) {
+                    same = same && a->x == b->x && a->width == b->width;
+                }
+                CHECK(!same) << "Uncoalesced bands at y " << band->y;
+            }
+        }
+        for (const Box *r = band; r != band_end; ++r) {
+            covered |= Rasterize(*r);
+            extents = extents.empty() ? *r : extents.Bound(*r);
+        }
+        previous_band = band;
+        previous_band_end = band_end;
+        band = band_end;
+    }
+    CHECK(covered == expected);
+    CHECK_EQ(region.empty(), expected.none());
+    const Box &e = region.extents();
+    CHECK(e.x == extents.x && e.y == extents.y && e.width == extents.width &&
+          e.height == extents.height);
+}
+
+// Random unions, intersections and subtractions against pixel sets.
+void TestOperations() {
+    ::std::mt19937 rng(1);
+    for (int round = 0; round < 2000; ++round) {
+        BoxRegion region;
+        Pixels pixels;
+        for (int step = 0; step < 12; ++step) {
+            BoxRegion operand;
+            Pixels operand_pixels;
+            const int boxes = rng() % 4 + 1;
+            for (int i = 0; i < boxes; ++i) {
+                const Box r = RandomBox(&rng);
+                operand.Union(r);
+                operand_pixels |= Rasterize(r);
+            }
+            Verify(operand, operand_pixels);
+            switch (rng() % 3) {
+                case 0:
+                    region.Union(operand);
+                    pixels |= operand_pixels;
+                    break;
+                case 1:
+                    region.Intersect(operand);
+                    pixels &= operand_pixels;
+                    break;
+                default:
+                    region.Subtract(operand);
+                    pixels &= ~operand_pixels;
+            }
+            Verify(region, pixels);
+            const Box r = RandomBox(&rng);
+            CHECK_EQ(region.Intersects(r), (pixels & Rasterize(r)).any());
+            const int x = static_cast<int>(rng() % SIDE) - MARGIN;
+            const int y = static_cast<int>(rng() % SIDE) - MARGIN;
+            CHECK_EQ(region.Contains(x, y), pixels.test(Bit(x, y)));
+        }
+    }
+}
+
+void TestRectangleOperands() {
+    BoxRegion a(Box{0, 0, 10, 10});
+    a.Subtract(Box{2, 2, 4, 4});
+    CHECK_EQ(a.size(), 4u);
+    a.Union(Box{2, 2, 4, 4});
+    CHECK_EQ(a.size(), 1u);
+    CHECK(a == BoxRegion(Box{0, 0, 10, 10}));
+    a.Intersect(Box{5, 5, 10, 10});
+    CHECK(a == BoxRegion(Box{5, 5, 5, 5}));
+    a.Subtract(Box{0, 0, 20, 20});
+    CHECK(a.empty());
+    CHECK(BoxRegion(Box{3, 3, 0, 5}).empty());
+}
+
+// Regions past INLINE_RECTS move to the heap; copies and moves keep them.
+void TestCopies() {
+    BoxRegion grid;
+    Pixels pixels;
+    for (int i = 0; i < 6; ++i) {
+        for (int j = 0; j < 6; ++j) {
+            const Box r{i * 8, j * 8, 4, 4};
+            grid.Union(r);
+            pixels |= Rasterize(r);
+        }
+    }
+    CHECK_GT(grid.size(), BoxRegion::INLINE_RECTS);
+    BoxRegion copy(grid);
+    CHECK(copy == grid);
+    BoxRegion small(Box{0, 0, 1, 1});
+    small = copy;
+    CHECK(small == grid);
+    BoxRegion moved(::std::move(copy));
+    CHECK(moved == grid);
+    copy = ::std::move(moved);
+    Verify(copy, pixels);
+
+    // Equal pixel sets built in different orders compare equal.
+    BoxRegion backwards;
+    for (auto r = grid.end(); r != grid.begin();) {
+        backwards.Union(*--r);
+    }
+    CHECK(backwards == grid);
+
+    copy.Translate(-3, 5);
+    Pixels shifted;
+    for (int y = -MARGIN; y < GRID + MARGIN; ++y) {
+        for (int x = -MARGIN; x < GRID + MARGIN; ++x) {
+            const int ox = x + 3, oy = y - 5;
+            if (ox >= -MARGIN && ox < GRID + MARGIN && oy >= -MARGIN && oy < GRID + MARGIN &&
+                pixels.test(Bit(ox, oy))) {
+                shifted.set(Bit(x, y));
+            }
+        }
+    }
+    Verify(copy, shifted);
+
+    copy.Clear();
+    CHECK(copy.empty());
+    CHECK(copy != grid);
+}
+
+}
+
+int main() {
+    TestOperations();
+    TestRectangleOperands();
+    TestCopies();
+    printf("region_test passed\n");
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "rules.h"
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <fnmatch.h>
+}
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <glog/logging.h>
+
+using ::std::string;
+
+namespace {
+
+// Parses one action into rule.
+bool ParseAction(const string &action, WindowRule *rule) {
+    if (action == "undecorated" || action == "decorated") {
+        rule->fields |= WindowRule::DECORATIONS;
+        rule->decorated = action == "decorated";
+        return true;
+    }
+    const size_t eq = action.find('=');
+    if (eq == string::npos)
+        return false;
+    const string key = action.substr(0, eq);
+    const string value = action.substr(eq + 1);
+    if (key == "workspace") {
+        char *end;
+        const long workspace = strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || workspace < 0)
+            return false;
+        rule->fields |= WindowRule::WORKSPACE;
+        rule->workspace = workspace;
+        return true;
+    }
+    if (key == "geometry") {
+        int x, y;
+        unsigned int width, height;
+        const int mask = XParseGeometry(value.c_str(), &x, &y, &width, &height);
+        if (mask == NoValue)
+            return false;
+        if ((mask & (WidthValue | HeightValue)) == (WidthValue | HeightValue)) {
+            rule->fields |= WindowRule::SIZE;
+            rule->width = width;
+            rule->height = height;
+        }
+        if ((mask & (XValue | YValue)) == (XValue | YValue)) {
+            rule->fields |= WindowRule::POSITION;
+            rule->x = x;
+            rule->y = y;
+            rule->x_negative = mask & XNegative;
+            rule->y_negative = mask & YNegative;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool IsGlob(const string &pattern) {
+    return pattern.find_first_of("*?[") != string::npos;
+}
+
+}
+
+void WindowRule::Merge(const WindowRule &other) {
+    if (other.fields & WORKSPACE)
+        workspace = other.workspace;
+    if (other.fields & DECORATIONS)
+        decorated = other.decorated;
+    if (other.fields & POSITION) {
+        x = other.x;
+        y = other.y;
+        x_negative = other.x_negative;
+        y_negative = other.y_negative;
+    }
+    if (other.fields & SIZE) {
+        width = other.width;
+        height = other.height;
+    }
+    fields |= other.fields;
+}
+
+bool WindowRules::Pattern::Matches(const string &value) const {
+    if (is_regex)
+        return ::std::regex_search(value, regex);
+    return fnmatch(glob.c_str(), value.c_str(), 0) == 0;
+}
+
+WindowRules::WindowRules(const string &path) {
+    ::std::ifstream in(path);
+    if (!in)
+        return;
+    Parse(in, path);
+    LOG(INFO) << "Loaded " << size_ << " window rules from " << path;
+}
+
+void WindowRules::Parse(::std::istream &in, const string &name) {
+    string line;
+    for (int number = 1; ::std::getline(in, line); ++number) {
+        const size_t comment = line.find('#');
+        if (comment != string::npos)
+            line.erase(comment);
+        ::std::istringstream words(line);
+        string field, pattern;
+        if (!(words >> field))
+            continue;
+
+        WindowRule rule;
+        bool valid = (field == "class" || field == "instance") && (words >> pattern);
+        string action;
+        while (valid && words >> action)
+            valid = ParseAction(action, &rule);
+        if (!valid || rule.fields == 0) {
+            LOG(WARNING) << name << ":" << number << ": ignoring malformed rule";
+            continue;
+        }
+
+        const bool on_class = field == "class";
+        if (pattern.size() > 2 && pattern.front() == '/' && pattern.back() == '/') {
+            Pattern p;
+            p.on_class = on_class;
+            p.is_regex = true;
+            try {
+                p.regex = ::std::regex(pattern.substr(1, pattern.size() - 2),
+                                       ::std::regex::ECMAScript | ::std::regex::optimize);
+            } catch (const ::std::regex_error &e) {
+                LOG(WARNING) << name << ":" << number << ": " << e.what();
+                continue;
+            }
+            p.rule = rule;
+            patterns_.push_back(::std::move(p));
+        } else if (IsGlob(pattern)) {
+            Pattern p;
+            p.on_class = on_class;
+            p.is_regex = false;
+            p.glob = pattern;
+            p.rule = rule;
+            patterns_.push_back(::std::move(p));
+        } else {
+            (on_class ? by_class_ : by_instance_)[pattern].Merge(rule);
+        }
+        ++size_;
+    }
+}
+
+bool WindowRules::Match(const string &instance, const string &wm_class,
+                        WindowRule *rule) const {
+    bool matched = false;
+    auto it = by_class_.find(wm_class);
+    if (it != by_class_.end()) {
+        rule->Merge(it->second);
+        matched = true;
+    }
+    it = by_instance_.find(instance);
+    if (it != by_instance_.end()) {
+        rule->Merge(it->second);
+        matched = true;
+    }
+    if (matched)
+        return true;
+
+    for (const Pattern &p : patterns_) {
+        if (p.Matches(p.on_class ? wm_class : instance)) {
+            rule->Merge(p.rule);
+            matched = true;
+        }
+    }
+    return matched;
+}
+
+string RulesPath() {
+    const char *path = getenv("SIMPLEWM_RULES");
+    if (path != nullptr && *path != '\0')
+        return path;
+    const char *config = getenv("XDG_CONFIG_HOME");
+    if (config != nullptr && *config != '\0')
+        return string(config) + "/simplewm/rules";
+    const char *home = getenv("HOME");
+    return string(home != nullptr ? home : "/tmp") + "/.config/simplewm/rules";
+}
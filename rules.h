@@ -0,0 +1,88 @@
+#ifndef SIMPLEWM_RULES_H
+#define SIMPLEWM_RULES_H
+
+#include <cstdint>
+#include <istream>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What a rule does to a window when it is framed. Only the fields named in
+// fields are set.
+struct WindowRule {
+    enum Field : uint8_t {
+        WORKSPACE = 1,
+        DECORATIONS = 2,
+        POSITION = 4,
+        SIZE = 8,
+    };
+
+    uint8_t fields = 0;
+    int workspace = 0;
+    bool decorated = true;
+    // Position of the frame in the work area; negative coordinates count
+    // from the right or bottom edge, as in X geometry strings.
+    int x = 0, y = 0;
+    bool x_negative = false, y_negative = false;
+    // Size of the client window.
+    unsigned int width = 0, height = 0;
+
+    // Overrides the fields other sets.
+    void Merge(const WindowRule &other);
+};
+
+// Per-application rules, matched against WM_CLASS when a window is framed.
+//
+// The rules file has one rule per line, "#" starting a comment:
+//
+//     class Firefox workspace=2
+//     instance xterm geometry=80x24-0+0
+//     class *Dialog undecorated
+//     instance /^gimp-[0-9.]+$/ workspace=3
+//
+// A rule matches the instance (res_name) or the class (res_class) of a
+// window. Exact rules are merged per name when the file is loaded, so
+// matching them costs one hash lookup per field; a class rule is applied
+// before an instance rule. Glob patterns and /regular expressions/ are only
+// tried, in file order, for windows no exact rule matched.
+class WindowRules {
+public:
+    WindowRules() = default;
+
+    // Loads a rules file. A missing file yields no rules, and malformed
+    // lines are logged and skipped.
+    explicit WindowRules(const ::std::string &path);
+
+    // Parses rules from in; name is used in log messages.
+    void Parse(::std::istream &in, const ::std::string &name);
+
+    // Merges the rules matching a window into rule. Returns whether any did.
+    bool Match(const ::std::string &instance, const ::std::string &wm_class,
+               WindowRule *rule) const;
+
+    size_t size() const { return size_; }
+
+private:
+    struct Pattern {
+        bool on_class;
+        // Set for regular expressions, otherwise glob is an fnmatch pattern.
+        bool is_regex;
+        ::std::string glob;
+        ::std::regex regex;
+        WindowRule rule;
+
+        bool Matches(const ::std::string &value) const;
+    };
+
+    ::std::unordered_map<::std::string, WindowRule> by_instance_;
+    ::std::unordered_map<::std::string, WindowRule> by_class_;
+    ::std::vector<Pattern> patterns_;
+    size_t size_ = 0;
+};
+
+// Returns the rules file: $SIMPLEWM_RULES if set, otherwise simplewm/rules
+// in $XDG_CONFIG_HOME or ~/.config.
+::std::string RulesPath();
+
+#endif
@@ -0,0 +1,205 @@
+#include "session.h"
+extern "C" {
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <glog/logging.h>
+
+using ::std::string;
+using ::std::unordered_map;
+using ::std::vector;
+
+namespace {
+
+const char MAGIC[8] = "SWMSES1";
+
+bool WriteAll(int fd, const void *data, size_t size) {
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        const ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void MakeParentDirs(const string &path) {
+    for (size_t i = path.find('/', 1); i != string::npos; i = path.find('/', i + 1)) {
+        mkdir(path.substr(0, i).c_str(), 0700);
+    }
+}
+
+}
+
+SessionStore::SessionStore(const string &path)
+    : path_(path),
+      stopping_(false) {
+    MakeParentDirs(path_);
+    Load();
+    writer_ = ::std::thread(&SessionStore::WriterLoop, this);
+}
+
+SessionStore::~SessionStore() {
+    {
+        ::std::lock_guard<::std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+}
+
+bool SessionStore::Lookup(uint64_t key, Box *outer) const {
+    auto it = geometry_.find(key);
+    if (it == geometry_.end())
+        return false;
+    *outer = it->second;
+    return true;
+}
+
+void SessionStore::Remember(uint64_t key, const Box &outer) {
+    Box &known = geometry_[key];
+    if (known.x == outer.x && known.y == outer.y &&
+        known.width == outer.width && known.height == outer.height)
+        return;
+    known = outer;
+    {
+        ::std::lock_guard<::std::mutex> lock(mutex_);
+        pending_[key] = outer;
+    }
+    wake_.notify_one();
+}
+
+uint64_t SessionStore::Key(const string &wm_class, const string &role) {
+    if (wm_class.empty())
+        return 0;
+    // 64-bit FNV-1a over "class\0role".
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](unsigned char c) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    };
+    for (char c : wm_class)
+        mix(c);
+    mix(0);
+    for (char c : role)
+        mix(c);
+    return hash != 0 ? hash : 1;
+}
+
+void SessionStore::Load() {
+    const int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    vector<char> data;
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR)) {
+        if (n > 0)
+            data.insert(data.end(), buffer, buffer + n);
+    }
+    close(fd);
+
+    if (data.size() < sizeof(MAGIC) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        LOG(WARNING) << "Ignoring malformed session file " << path_;
+        Compact();
+        return;
+    }
+    // A trailing partial record is left over from an interrupted write.
+    const size_t count = (data.size() - sizeof(MAGIC)) / sizeof(Record);
+    const Record *records = reinterpret_cast<const Record *>(data.data() + sizeof(MAGIC));
+    for (size_t i = 0; i < count; ++i) {
+        Record r;
+        memcpy(&r, records + i, sizeof(r));
+        Box &outer = geometry_[r.key];
+        outer.x = r.x;
+        outer.y = r.y;
+        outer.width = r.width;
+        outer.height = r.height;
+    }
+    LOG(INFO) << "Loaded geometry of " << geometry_.size() << " windows from " << path_;
+    if (count > 2 * geometry_.size() + 64 ||
+        data.size() != sizeof(MAGIC) + count * sizeof(Record))
+        Compact();
+}
+
+void SessionStore::Compact() {
+    vector<Record> records;
+    records.reserve(geometry_.size());
+    for (const auto &entry : geometry_) {
+        records.push_back(Record{entry.first, entry.second.x, entry.second.y,
+                                 entry.second.width, entry.second.height});
+    }
+    const string tmp = path_ + ".tmp";
+    const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        PLOG(ERROR) << "Cannot write " << tmp;
+        return;
+    }
+    const bool ok = WriteAll(fd, MAGIC, sizeof(MAGIC)) &&
+                    WriteAll(fd, records.data(), records.size() * sizeof(Record));
+    close(fd);
+    if (!ok || rename(tmp.c_str(), path_.c_str()) < 0) {
+        PLOG(ERROR) << "Cannot write " << path_;
+        unlink(tmp.c_str());
+    }
+}
+
+void SessionStore::WriterLoop() {
+    ::std::unique_lock<::std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+        // Give a move in progress the chance to settle, so that one write
+        // covers it.
+        wake_.wait_for(lock, ::std::chrono::milliseconds(WRITE_DELAY_MS),
+                       [this]() { return stopping_; });
+        unordered_map<uint64_t, Box> batch;
+        batch.swap(pending_);
+        const bool stopping = stopping_;
+        lock.unlock();
+
+        if (!batch.empty()) {
+            vector<Record> records;
+            records.reserve(batch.size());
+            for (const auto &entry : batch) {
+                records.push_back(Record{entry.first, entry.second.x, entry.second.y,
+                                         entry.second.width, entry.second.height});
+            }
+            const int fd = open(path_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) < 0 ||
+                (st.st_size == 0 && !WriteAll(fd, MAGIC, sizeof(MAGIC))) ||
+                !WriteAll(fd, records.data(), records.size() * sizeof(Record))) {
+                PLOG(ERROR) << "Cannot append to " << path_;
+            }
+            if (fd >= 0)
+                close(fd);
+        }
+
+        lock.lock();
+        if (stopping && pending_.empty())
+            return;
+    }
+}
+
+string SessionPath() {
+    const char *path = getenv("SIMPLEWM_SESSION");
+    if (path != nullptr && *path != '\0')
+        return path;
+    const char *state = getenv("XDG_STATE_HOME");
+    if (state != nullptr && *state != '\0')
+        return string(state) + "/simplewm.session";
+    const char *home = getenv("HOME");
+    return string(home != nullptr ? home : "/tmp") + "/.local/state/simplewm.session";
+}
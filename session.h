@@ -0,0 +1,69 @@
+#ifndef SIMPLEWM_SESSION_H
+#define SIMPLEWM_SESSION_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "geometry_index.h"
+
+// Remembers the frame geometry of windows across sessions.
+//
+// Windows are identified by a hash of their WM_CLASS and WM_WINDOW_ROLE.
+// The session file is an append-only log of fixed-size binary records, the
+// last record for a key winning; it is read once on construction and
+// compacted then if it has grown too much. Remember() only updates memory
+// and queues the record; a writer thread appends queued records in
+// batches, so window moves never wait for the disk.
+class SessionStore {
+public:
+    explicit SessionStore(const ::std::string &path);
+
+    // Writes the remaining records and stops the writer thread.
+    ~SessionStore();
+
+    // Returns the remembered outer frame rectangle for a key.
+    bool Lookup(uint64_t key, Box *outer) const;
+
+    // Records the outer frame rectangle for a key.
+    void Remember(uint64_t key, const Box &outer);
+
+    // Returns the key for a window, or 0 if it has no WM_CLASS.
+    static uint64_t Key(const ::std::string &wm_class, const ::std::string &role);
+
+private:
+    // Time the writer waits to collect more records into one write.
+    static constexpr int WRITE_DELAY_MS = 500;
+
+    struct Record {
+        uint64_t key;
+        int32_t x, y;
+        int32_t width, height;
+    };
+
+    void Load();
+
+    // Rewrites the file with one record per key.
+    void Compact();
+
+    void WriterLoop();
+
+    const ::std::string path_;
+    // Only used by the window manager thread.
+    ::std::unordered_map<uint64_t, Box> geometry_;
+
+    ::std::mutex mutex_;
+    ::std::condition_variable wake_;
+    // Records not written yet, guarded by mutex_.
+    ::std::unordered_map<uint64_t, Box> pending_;
+    bool stopping_;
+    ::std::thread writer_;
+};
+
+// Returns the session file: $SIMPLEWM_SESSION if set, otherwise
+// simplewm.session in $XDG_STATE_HOME or ~/.local/state.
+::std::string SessionPath();
+
+#endif
@@ -0,0 +1,131 @@
+#include "session.h"
+extern "C" {
+#include <sys/stat.h>
+#include <unistd.h>
+}
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <glog/logging.h>
+
+using ::std::string;
+
+namespace {
+
+// Size of the file header and of one record.
+const off_t HEADER = 8;
+const off_t RECORD = 24;
+
+off_t FileSize(const string &path) {
+    struct stat st;
+    CHECK_EQ(stat(path.c_str(), &st), 0) << path;
+    return st.st_size;
+}
+
+void Append(const string &path, const char *data, size_t size) {
+    FILE *f = fopen(path.c_str(), "ab");
+    CHECK(f != nullptr) << path;
+    CHECK_EQ(fwrite(data, 1, size, f), size);
+    fclose(f);
+}
+
+bool Knows(const SessionStore &store, uint64_t key) {
+    Box outer;
+    return store.Lookup(key, &outer);
+}
+
+bool Has(const SessionStore &store, uint64_t key, const Box &expected) {
+    Box outer;
+    return store.Lookup(key, &outer) && outer.x == expected.x && outer.y == expected.y &&
+           outer.width == expected.width && outer.height == expected.height;
+}
+
+void TestKey() {
+    CHECK_EQ(SessionStore::Key("", "role"), 0u);
+    CHECK_NE(SessionStore::Key("XTerm", ""), 0u);
+    CHECK_EQ(SessionStore::Key("XTerm", "a"), SessionStore::Key("XTerm", "a"));
+    CHECK_NE(SessionStore::Key("XTerm", "a"), SessionStore::Key("XTerm", "b"));
+    // The class and the role are separated.
+    CHECK_NE(SessionStore::Key("ab", "c"), SessionStore::Key("a", "bc"));
+}
+
+void TestRoundTrip(const string &dir) {
+    // Missing parent directories are created.
+    const string path = dir + "/state/simplewm.session";
+    {
+        SessionStore store(path);
+        CHECK(!Knows(store, 1));
+        store.Remember(1, Box{10, 20, 300, 200});
+        store.Remember(2, Box{-5, 0, 640, 480});
+        store.Remember(1, Box{11, 21, 301, 201});
+        CHECK(Has(store, 1, Box{11, 21, 301, 201}));
+    }
+    // The destructor writes what is queued without waiting for the delay.
+    SessionStore store(path);
+    CHECK(Has(store, 1, Box{11, 21, 301, 201}));
+    CHECK(Has(store, 2, Box{-5, 0, 640, 480}));
+    CHECK(!Knows(store, 3));
+}
+
+void TestPartialRecord(const string &dir) {
+    const string path = dir + "/partial.session";
+    {
+        SessionStore store(path);
+        store.Remember(7, Box{1, 2, 3, 4});
+    }
+    CHECK_EQ(FileSize(path), HEADER + RECORD);
+    // An interrupted write leaves part of a record behind.
+    Append(path, "\x07\0\0\0\0", 5);
+    {
+        SessionStore store(path);
+        CHECK(Has(store, 7, Box{1, 2, 3, 4}));
+    }
+    // Loading compacted the file back to whole records.
+    CHECK_EQ(FileSize(path), HEADER + RECORD);
+}
+
+void TestMalformed(const string &dir) {
+    const string path = dir + "/malformed.session";
+    Append(path, "not a session file", 18);
+    {
+        SessionStore store(path);
+        CHECK(!Knows(store, 0));
+        store.Remember(5, Box{0, 0, 100, 100});
+    }
+    SessionStore store(path);
+    CHECK(Has(store, 5, Box{0, 0, 100, 100}));
+    CHECK_EQ(FileSize(path), HEADER + RECORD);
+}
+
+void TestCompaction(const string &dir) {
+    const string path = dir + "/compact.session";
+    // Every store appends a record per key; the log grows with each run.
+    for (int run = 0; run < 40; ++run) {
+        SessionStore store(path);
+        for (uint64_t key = 1; key <= 3; ++key) {
+            store.Remember(key, Box{run, 0, 100, 100});
+        }
+    }
+    SessionStore store(path);
+    for (uint64_t key = 1; key <= 3; ++key) {
+        CHECK(Has(store, key, Box{39, 0, 100, 100}));
+    }
+    // Never more than 2 * keys + 64 records survive a load.
+    CHECK_LE(FileSize(path), HEADER + (2 * 3 + 64 + 3) * RECORD);
+}
+
+}
+
+int main() {
+    char dir[] = "/tmp/session_test.XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    TestKey();
+    TestRoundTrip(dir);
+    TestPartialRecord(dir);
+    TestMalformed(dir);
+    TestCompaction(dir);
+    const string cleanup = string("rm -rf ") + dir;
+    CHECK_EQ(system(cleanup.c_str()), 0);
+    printf("session_test passed\n");
+    return 0;
+}
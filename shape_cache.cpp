@@ -0,0 +1,107 @@
+#include "shape_cache.h"
+extern "C" {
+#include <X11/extensions/shape.h>
+}
+#include <algorithm>
+#include <cmath>
+
+using ::std::vector;
+
+ShapeCache::ShapeCache(Display *display, size_t capacity)
+    : display_(display),
+      capacity_(capacity) {
+    int event_base, error_base;
+    ok_ = XShapeQueryExtension(display_, &event_base, &error_base);
+}
+
+void ShapeCache::Apply(Window frame, int width, int height, int border, int radius,
+                       bool see_through) {
+    // The shape covers the inside of the border only if it is see-through.
+    const int inset = see_through ? border : 0;
+    if (!ok_ || width <= 2 * inset || height <= 2 * inset) {
+        return;
+    }
+    Key key;
+    key.width = width - 2 * inset;
+    key.height = height - 2 * inset;
+    key.radius = ::std::max(0, ::std::min(radius, ::std::min(key.width, key.height) / 2));
+    if (key.radius == 0 && !see_through) {
+        XShapeCombineMask(display_, frame, ShapeBounding, 0, 0, None, ShapeSet);
+        return;
+    }
+    const vector<XRectangle> &rects = Lookup(key);
+    XShapeCombineRectangles(
+            display_,
+            frame,
+            ShapeBounding,
+            inset - border,
+            inset - border,
+            const_cast<XRectangle *>(rects.data()),
+            rects.size(),
+            ShapeSet,
+            YXBanded);
+}
+
+const vector<short> &ShapeCache::Insets(int radius) {
+    auto it = insets_.find(radius);
+    if (it != insets_.end()) {
+        return it->second;
+    }
+    vector<short> &insets = insets_[radius];
+    insets.resize(radius);
+    for (int row = 0; row < radius; ++row) {
+        const double dy = radius - row - 0.5;
+        const double dx = std::sqrt(static_cast<double>(radius) * radius - dy * dy);
+        insets[row] = static_cast<short>(std::lround(radius - dx));
+    }
+    return insets;
+}
+
+const vector<XRectangle> &ShapeCache::Lookup(const Key &key) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
+    }
+
+    const vector<short> &insets = Insets(key.radius);
+    vector<XRectangle> rects;
+    rects.reserve(2 * key.radius + 1);
+    auto add = [&](int inset, int y, int h) {
+        XRectangle r;
+        r.x = inset;
+        r.y = y;
+        r.width = key.width - 2 * inset;
+        r.height = h;
+        rects.push_back(r);
+    };
+    // Rows with the same inset share a rectangle.
+    for (int row = 0; row < key.radius;) {
+        int end = row + 1;
+        while (end < key.radius && insets[end] == insets[row]) {
+            ++end;
+        }
+        add(insets[row], row, end - row);
+        row = end;
+    }
+    add(0, key.radius, key.height - 2 * key.radius);
+    for (int row = key.radius - 1; row >= 0;) {
+        int begin = row - 1;
+        while (begin >= 0 && insets[begin] == insets[row]) {
+            --begin;
+        }
+        add(insets[row], key.height - row - 1, row - begin);
+        row = begin;
+    }
+    rects.erase(::std::remove_if(rects.begin(), rects.end(),
+                                 [](const XRectangle &r) { return r.height == 0; }),
+                rects.end());
+
+    if (entries_.size() >= capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+    entries_.emplace_front(key, ::std::move(rects));
+    index_[key] = entries_.begin();
+    return entries_.front().second;
+}
@@ -0,0 +1,62 @@
+#ifndef SIMPLEWM_SHAPE_CACHE_H
+#define SIMPLEWM_SHAPE_CACHE_H
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Gives frames rounded corners through the Shape extension.
+//
+// A bounding shape is a list of rectangles: one per row of each corner and
+// one for the body in between. Corner row insets are computed once per
+// radius, and complete shapes are kept in an LRU keyed by (width, height,
+// radius), so resizing a frame to a recently used size costs a single
+// ShapeRectangles request and no client-side work.
+class ShapeCache {
+public:
+    ShapeCache(Display *display, size_t capacity);
+
+    // Whether the server supports the Shape extension.
+    bool ok() const { return ok_; }
+
+    // Sets the bounding shape of a frame with the given outer size, which
+    // includes border pixels of border on each side. A see-through border
+    // is left out of the shape, so what lies below shows through it.
+    void Apply(Window frame, int width, int height, int border, int radius, bool see_through);
+
+private:
+    struct Key {
+        int width, height, radius;
+
+        bool operator == (const Key &o) const {
+            return width == o.width && height == o.height && radius == o.radius;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator () (const Key &k) const {
+            return (static_cast<size_t>(k.width) * 73856093u) ^
+                   (static_cast<size_t>(k.height) * 19349663u) ^
+                   (static_cast<size_t>(k.radius) * 83492791u);
+        }
+    };
+
+    typedef ::std::list<::std::pair<Key, ::std::vector<XRectangle>>> Entries;
+
+    // Returns the horizontal inset of each corner row for a radius.
+    const ::std::vector<short> &Insets(int radius);
+
+    const ::std::vector<XRectangle> &Lookup(const Key &key);
+
+    Display *display_;
+    bool ok_;
+    const size_t capacity_;
+    Entries entries_;
+    ::std::unordered_map<Key, Entries::iterator, KeyHash> index_;
+    ::std::unordered_map<int, ::std::vector<short>> insets_;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "flight_recorder.h"
+#include "util.h"
+
+using ::std::vector;
+
+namespace {
+
+const char *ErrorName(int code) {
+    static const char *const X_ERROR_NAMES[] = {
+            "Success",
+            "BadRequest",
+            "BadValue",
+            "BadWindow",
+            "BadPixmap",
+            "BadAtom",
+            "BadCursor",
+            "BadFont",
+            "BadMatch",
+            "BadDrawable",
+            "BadAccess",
+            "BadAlloc",
+            "BadColor",
+            "BadGC",
+            "BadIDChoice",
+            "BadName",
+            "BadLength",
+            "BadImplementation",
+    };
+    if (code < 0 || code >= static_cast<int>(sizeof(X_ERROR_NAMES) / sizeof(X_ERROR_NAMES[0])))
+        return "extension error";
+    return X_ERROR_NAMES[code];
+}
+
+// A record copied out of the dump. FlightRecord itself holds an atomic and
+// cannot be copied.
+struct Entry {
+    uint64_t sequence;
+    const FlightRecord *record;
+};
+
+}
+
+// Prints a flight recorder dump, oldest record first, with times relative
+// to the dump.
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <dump>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    ::std::ifstream in(argv[1], ::std::ios::binary);
+    FlightDumpHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, "SWMFLT1", 8) != 0 ||
+        header.record_size != sizeof(FlightRecord)) {
+        fprintf(stderr, "%s: not a flight recorder dump\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    vector<FlightRecord> records(header.capacity);
+    if (!in.read(reinterpret_cast<char *>(records.data()),
+                 sizeof(FlightRecord) * header.capacity)) {
+        fprintf(stderr, "%s: truncated dump\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    // Skip records that were being written, or overwritten, during the dump.
+    vector<Entry> entries;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const uint64_t sequence = records[i].sequence.load(::std::memory_order_relaxed);
+        if (sequence == 0 || ((sequence - 1) & (header.capacity - 1)) != i)
+            continue;
+        entries.push_back(Entry{sequence, &records[i]});
+    }
+    ::std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.sequence < b.sequence;
+    });
+
+    if (header.signal != 0)
+        printf("dumped on signal %d (%s)\n", header.signal, strsignal(header.signal));
+    else
+        printf("dumped on failed CHECK\n");
+    printf("%zu of %llu records\n", entries.size(), static_cast<unsigned long long>(header.head));
+
+    for (const Entry &entry : entries) {
+        const FlightRecord &r = *entry.record;
+        const double seconds = (static_cast<double>(r.time_us) - header.time_us) / 1e6;
+        printf("%12.6f  #%-8u ", seconds, r.serial);
+        switch (r.kind) {
+            case FlightRecord::EVENT:
+                printf("event   %-18s", XEventTypeToString(r.code).c_str());
+                break;
+            case FlightRecord::REQUEST:
+                printf("request %-18s", XRequestCodeToString(r.code).c_str());
+                break;
+            case FlightRecord::ERROR:
+                printf("error   %-18s request %s", ErrorName(r.code),
+                       XRequestCodeToString(r.detail).c_str());
+                break;
+            default:
+                printf("unknown record kind %d", r.kind);
+                break;
+        }
+        printf(" window 0x%x", r.window);
+        if (r.arg != 0)
+            printf(" arg 0x%x", r.arg);
+        if (r.kind == FlightRecord::EVENT && r.detail != 0)
+            printf(" detail %u", r.detail);
+        printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
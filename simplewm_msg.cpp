@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+extern "C" {
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+#include "ipc.h"
+
+using ::std::string;
+
+// Sends commands to a running simplewm and prints the replies.
+//
+// Each argument is one command. Without arguments, commands are read from
+// standard input, one per line, and sent as a single batch.
+int main(int argc, char** argv) {
+    string batch;
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            batch += argv[i];
+            batch += '\n';
+        }
+    } else {
+        string line;
+        while (::std::getline(::std::cin, line)) {
+            batch += line;
+            batch += '\n';
+        }
+    }
+
+    const string path = IpcSocketPath();
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        perror(path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    size_t written = 0;
+    while (written < batch.size()) {
+        const ssize_t n = write(fd, batch.data() + written, batch.size() - written);
+        if (n < 0) {
+            perror("write");
+            return EXIT_FAILURE;
+        }
+        written += n;
+    }
+    shutdown(fd, SHUT_WR);
+
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        fwrite(buffer, 1, n, stdout);
+    }
+    close(fd);
+    return EXIT_SUCCESS;
+}
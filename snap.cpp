@@ -0,0 +1,84 @@
+#include "snap.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using ::std::vector;
+
+namespace {
+
+// Tracks the smallest correction along one axis.
+struct AxisSnap {
+    int best;
+    int delta;
+
+    explicit AxisSnap(int threshold)
+        : best(threshold + 1), delta(0) {
+    }
+
+    // Considers aligning the edges at from (on the moving frame) and to.
+    void Offer(int from, int to) {
+        const int d = to - from;
+        if (::std::abs(d) < best) {
+            best = ::std::abs(d);
+            delta = d;
+        }
+    }
+
+    // Considers all four pairings of the near and far edges of a span.
+    void OfferSpan(int lo, int hi, int other_lo, int other_hi) {
+        Offer(lo, other_lo);
+        Offer(lo, other_hi);
+        Offer(hi, other_lo);
+        Offer(hi, other_hi);
+    }
+};
+
+// Whether two spans overlap once widened by threshold.
+bool Near(int lo, int hi, int other_lo, int other_hi, int threshold) {
+    return lo - threshold < other_hi && other_lo < hi + threshold;
+}
+
+}
+
+Position<int> SnapFrame(
+        const GeometryIndex &index,
+        const vector<Window> &moved,
+        const Box &screen,
+        const Box &moving,
+        int threshold) {
+    if (threshold <= 0) {
+        return Position<int>(moving.x, moving.y);
+    }
+
+    AxisSnap x(threshold), y(threshold);
+    x.Offer(moving.x, screen.x);
+    x.Offer(moving.right(), screen.right());
+    y.Offer(moving.y, screen.y);
+    y.Offer(moving.bottom(), screen.bottom());
+
+    Box area;
+    area.x = moving.x - threshold;
+    area.y = moving.y - threshold;
+    area.width = moving.width + 2 * threshold;
+    area.height = moving.height + 2 * threshold;
+    vector<Window> nearby;
+    index.Query(area, &nearby);
+
+    for (Window frame : nearby) {
+        Box other;
+        if (::std::find(moved.begin(), moved.end(), frame) != moved.end() ||
+            !index.Get(frame, &other)) {
+            continue;
+        }
+        // Vertical edges only matter if the frames share rows, and vice versa.
+        if (Near(moving.y, moving.bottom(), other.y, other.bottom(), threshold)) {
+            x.OfferSpan(moving.x, moving.right(), other.x, other.right());
+        }
+        if (Near(moving.x, moving.right(), other.x, other.right(), threshold)) {
+            y.OfferSpan(moving.y, moving.bottom(), other.y, other.bottom());
+        }
+    }
+
+    return Position<int>(moving.x + x.delta, moving.y + y.delta);
+}
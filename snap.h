@@ -0,0 +1,25 @@
+#ifndef SIMPLEWM_SNAP_H
+#define SIMPLEWM_SNAP_H
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <vector>
+#include "geometry_index.h"
+#include "util.h"
+
+// Returns the position a frame being dragged to moving should snap to.
+//
+// Edges of moving snap to the edges of screen and to the edges of other
+// mapped frames that are within threshold pixels. Only frames the index
+// reports near moving are considered, so the cost does not grow with the
+// number of windows elsewhere on screen. The frames in moved, i.e. moving
+// itself and the frames of its group moving along, are excluded.
+Position<int> SnapFrame(
+        const GeometryIndex &index,
+        const ::std::vector<Window> &moved,
+        const Box &screen,
+        const Box &moving,
+        int threshold);
+
+#endif
@@ -3,19 +3,54 @@
 extern "C" {
 #include <X11/Xlib.h>
 }
+#include "geometry_index.h"
+#include "pool.h"
+#include "timer_wheel.h"
 
 typedef struct {
     Window win;
+    unsigned int width;
     Window closeIcon;
     GC closeGC;
     Window maximizeIcon;
     Window minimizeIcon;
 } MenuBar;
 
+// Liveness state of a client, see WindowManager::sendPing().
+typedef struct {
+    bool supported;
+    bool hung;
+    // Whether the client was asked to close and is killed if it hangs.
+    bool closing;
+    long serial;
+    TimerId timeout;
+} PingState;
+
 typedef struct {
     MenuBar topBar;
     Window frame;
     Window w;
+    int workspace;
+    PingState ping;
+    // Identifies the window across sessions, 0 if it has no WM_CLASS.
+    uint64_t sessionKey;
+    bool maximized;
+    // Minimized clients are unmapped along with their frame.
+    bool minimized;
+    // UnmapNotify events of the client that the window manager caused and
+    // that are no withdrawal.
+    int ignoreUnmaps;
+    // Outer frame geometry to return to when unmaximizing.
+    Box restore;
+    // Undecorated clients fill their frame; the title bar stays unmapped.
+    bool undecorated;
+    // Cached WM_TRANSIENT_FOR and WM_HINTS window group, None if unset.
+    Window transientFor;
+    Window leader;
+    // Key of the client's group in WindowManager::groups_, and the next
+    // member of the group.
+    Window group;
+    Handle groupNext;
 } ClientWin;
 
 typedef struct {
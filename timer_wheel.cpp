@@ -0,0 +1,184 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+TimerWheel::TimerWheel(uint64_t now_ms)
+    : now_(now_ms),
+      count_(0) {
+    ::std::fill(heads_, heads_ + LEVELS * SLOTS, NIL);
+    ::std::fill(occupied_, occupied_ + LEVELS, 0);
+}
+
+uint64_t TimerWheel::Now() {
+    return ::std::chrono::duration_cast<::std::chrono::milliseconds>(
+            ::std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TimerId TimerWheel::Schedule(uint64_t delay_ms, Callback callback) {
+    uint32_t index;
+    if (!free_.empty()) {
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        index = nodes_.size();
+        nodes_.emplace_back();
+        nodes_[index].generation = 0;
+    }
+    Node &node = nodes_[index];
+    // A timer never runs in the tick it was scheduled in, so that a callback
+    // rescheduling itself cannot starve the loop.
+    node.expires = now_ + ::std::max<uint64_t>(delay_ms, 1);
+    node.callback = ::std::move(callback);
+    Link(index);
+    ++count_;
+    return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    const uint32_t index = static_cast<uint32_t>(id & 0xFFFFFFFF) - 1;
+    if (id == 0 || index >= nodes_.size()) {
+        return false;
+    }
+    Node &node = nodes_[index];
+    if (node.slot < 0 || node.generation != static_cast<uint32_t>(id >> 32)) {
+        return false;
+    }
+    Unlink(index);
+    node.callback = nullptr;
+    ++node.generation;
+    free_.push_back(index);
+    --count_;
+    return true;
+}
+
+void TimerWheel::Advance(uint64_t now_ms) {
+    while (true) {
+        // 1. Run everything due in the current tick.
+        const int slot = now_ & (SLOTS - 1);
+        while (heads_[slot] != NIL) {
+            const uint32_t index = heads_[slot];
+            Unlink(index);
+            Node &node = nodes_[index];
+            if (node.expires > now_) {
+                Link(index);
+                continue;
+            }
+            Callback callback = ::std::move(node.callback);
+            node.callback = nullptr;
+            ++node.generation;
+            free_.push_back(index);
+            --count_;
+            callback();
+        }
+
+        if (now_ >= now_ms) {
+            return;
+        }
+        if (count_ == 0) {
+            now_ = now_ms;
+            return;
+        }
+
+        // 2. Skip to the next occupied tick or the next cascade, whichever
+        //    comes first.
+        const uint64_t boundary = (now_ | (SLOTS - 1)) + 1;
+        const int distance = NextOccupied(0);
+        const uint64_t next = distance > 0 ? ::std::min(now_ + distance, boundary) : boundary;
+        if (next > now_ms) {
+            now_ = now_ms;
+            return;
+        }
+        now_ = next;
+        if ((now_ & (SLOTS - 1)) == 0) {
+            Cascade();
+        }
+    }
+}
+
+int TimerWheel::NextTimeout() const {
+    if (count_ == 0) {
+        return -1;
+    }
+    if (heads_[now_ & (SLOTS - 1)] != NIL) {
+        return 0;
+    }
+    uint64_t best = UINT64_MAX;
+    for (int level = 0; level < LEVELS; ++level) {
+        const int distance = NextOccupied(level);
+        if (distance == 0) {
+            continue;
+        }
+        // Timers at higher levels may expire anywhere within their slot; the
+        // start of the slot is when they cascade.
+        const int shift = BITS * level;
+        const uint64_t start = ((now_ >> shift) + distance) << shift;
+        best = ::std::min(best, start - now_);
+    }
+    return static_cast<int>(::std::min<uint64_t>(best, INT_MAX));
+}
+
+void TimerWheel::Link(uint32_t index) {
+    Node &node = nodes_[index];
+    const uint64_t diff = node.expires > now_ ? node.expires - now_ : 0;
+    int level = 0;
+    while (level < LEVELS - 1 && diff >= (uint64_t(1) << (BITS * (level + 1)))) {
+        ++level;
+    }
+    // Timers beyond the range of the wheel wait in the last slot of the top
+    // level and are re-linked when it cascades.
+    const uint64_t range = uint64_t(1) << (BITS * LEVELS);
+    const uint64_t expires = diff < range ? node.expires : now_ + range - 1;
+    const int slot = level * SLOTS + ((expires >> (BITS * level)) & (SLOTS - 1));
+
+    node.slot = slot;
+    node.prev = NIL;
+    node.next = heads_[slot];
+    if (node.next != NIL) {
+        nodes_[node.next].prev = index;
+    }
+    heads_[slot] = index;
+    occupied_[level] |= uint64_t(1) << (slot & (SLOTS - 1));
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Node &node = nodes_[index];
+    if (node.prev != NIL) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[node.slot] = node.next;
+    }
+    if (node.next != NIL) {
+        nodes_[node.next].prev = node.prev;
+    }
+    if (heads_[node.slot] == NIL) {
+        occupied_[node.slot / SLOTS] &= ~(uint64_t(1) << (node.slot & (SLOTS - 1)));
+    }
+    node.slot = -1;
+}
+
+void TimerWheel::Cascade() {
+    for (int level = 1; level < LEVELS; ++level) {
+        const int index = (now_ >> (BITS * level)) & (SLOTS - 1);
+        const int slot = level * SLOTS + index;
+        while (heads_[slot] != NIL) {
+            const uint32_t node = heads_[slot];
+            Unlink(node);
+            Link(node);
+        }
+        if (index != 0) {
+            break;
+        }
+    }
+}
+
+int TimerWheel::NextOccupied(int level) const {
+    const uint64_t bits = occupied_[level];
+    if (bits == 0) {
+        return 0;
+    }
+    const int current = (now_ >> (BITS * level)) & (SLOTS - 1);
+    const int shift = (current + 1) & (SLOTS - 1);
+    const uint64_t rotated = shift == 0 ? bits : (bits >> shift) | (bits << (SLOTS - shift));
+    return __builtin_ctzll(rotated) + 1;
+}
@@ -0,0 +1,77 @@
+#ifndef SIMPLEWM_TIMER_WHEEL_H
+#define SIMPLEWM_TIMER_WHEEL_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Identifies a scheduled timer. 0 never identifies a timer.
+typedef uint64_t TimerId;
+
+// Hierarchical timing wheel with millisecond ticks.
+//
+// Scheduling and cancelling are O(1). Timers live in one of LEVELS wheels of
+// SLOTS slots each, the wheel being picked by how far in the future they
+// expire; they cascade into finer wheels as their expiry approaches. The
+// owner polls with NextTimeout() as its timeout and calls Advance() when it
+// wakes up, so an idle wheel causes no wakeups at all.
+class TimerWheel {
+public:
+    typedef ::std::function<void()> Callback;
+
+    explicit TimerWheel(uint64_t now_ms);
+
+    // Runs callback delay_ms milliseconds after the current time.
+    TimerId Schedule(uint64_t delay_ms, Callback callback);
+
+    // Cancels a pending timer. Returns false if it already ran or was
+    // cancelled.
+    bool Cancel(TimerId id);
+
+    // Runs all timers expiring at or before now_ms, in expiry order.
+    void Advance(uint64_t now_ms);
+
+    // Returns the milliseconds until the next timer may expire, suitable as
+    // a poll() timeout, or -1 if no timer is pending.
+    int NextTimeout() const;
+
+    size_t size() const { return count_; }
+
+    // Returns the current time of the monotonic clock in milliseconds.
+    static uint64_t Now();
+
+private:
+    static const int BITS = 6;
+    static const int SLOTS = 1 << BITS;
+    static const int LEVELS = 4;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        uint64_t expires;
+        Callback callback;
+        uint32_t generation;
+        uint32_t prev, next;
+        // Slot the node is linked into, or -1 if it is free.
+        int slot;
+    };
+
+    void Link(uint32_t index);
+
+    void Unlink(uint32_t index);
+
+    void Cascade();
+
+    // Returns the first slot list at level, relative to the current time,
+    // that is not empty, as a distance in slots (1 to SLOTS), or 0 if the
+    // level is empty.
+    int NextOccupied(int level) const;
+
+    uint64_t now_;
+    size_t count_;
+    ::std::vector<Node> nodes_;
+    ::std::vector<uint32_t> free_;
+    uint32_t heads_[LEVELS * SLOTS];
+    uint64_t occupied_[LEVELS];
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "timer_wheel.h"
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+#include <glog/logging.h>
+
+using ::std::vector;
+
+namespace {
+
+void TestOrder() {
+    TimerWheel wheel(1000);
+    vector<int> ran;
+    // One timer per level, and one beyond the range of the wheel.
+    const uint64_t delays[] = {20000000, 300000, 5000, 64, 63, 1};
+    for (size_t i = 0; i < 6; ++i) {
+        wheel.Schedule(delays[i], [&ran, i]() { ran.push_back(i); });
+    }
+    wheel.Advance(1000 + 20000000);
+    CHECK_EQ(ran.size(), 6u);
+    for (size_t i = 0; i < 6; ++i) {
+        CHECK_EQ(ran[i], static_cast<int>(5 - i));
+    }
+    CHECK_EQ(wheel.size(), 0u);
+    CHECK_EQ(wheel.NextTimeout(), -1);
+}
+
+void TestCancel() {
+    TimerWheel wheel(0);
+    bool ran = false;
+    const TimerId id = wheel.Schedule(10, [&ran]() { ran = true; });
+    CHECK(wheel.Cancel(id));
+    CHECK(!wheel.Cancel(id));
+    wheel.Advance(100);
+    CHECK(!ran);
+    // A reused node does not answer to the old id.
+    const TimerId reused = wheel.Schedule(10, [&ran]() { ran = true; });
+    CHECK(!wheel.Cancel(id));
+    wheel.Advance(110);
+    CHECK(ran);
+    CHECK(!wheel.Cancel(reused));
+    CHECK(!wheel.Cancel(0));
+}
+
+void TestScheduleFromCallback() {
+    TimerWheel wheel(0);
+    int runs = 0;
+    ::std::function<void()> again = [&]() {
+        if (++runs < 3) {
+            wheel.Schedule(0, again);
+        }
+    };
+    wheel.Schedule(0, again);
+    // Zero delays wait for the next tick, so each Advance runs one.
+    wheel.Advance(1);
+    CHECK_EQ(runs, 1);
+    wheel.Advance(1);
+    CHECK_EQ(runs, 1);
+    wheel.Advance(3);
+    CHECK_EQ(runs, 3);
+}
+
+// Random schedules, cancels and advances against a sorted reference: every
+// timer runs in the first Advance that reaches its expiry, in expiry order,
+// and NextTimeout never sleeps past the earliest one.
+void TestRandom() {
+    ::std::mt19937 rng(1);
+    uint64_t now = 5;
+    TimerWheel wheel(now);
+    ::std::multimap<uint64_t, TimerId> expected;
+    ::std::map<TimerId, uint64_t> expiry;
+    vector<uint64_t> ran;
+    for (int step = 0; step < 50000; ++step) {
+        const int action = rng() % 10;
+        if (action < 5) {
+            const uint64_t delay = rng() % 4 == 0 ? rng() % 20000000 : rng() % 200;
+            const uint64_t expires = now + ::std::max<uint64_t>(delay, 1);
+            // The callback only knows its expiry; ids are checked below.
+            const TimerId id = wheel.Schedule(delay, [&ran, &now, expires]() {
+                CHECK_LE(expires, now);
+                ran.push_back(expires);
+            });
+            expected.emplace(expires, id);
+            expiry[id] = expires;
+        } else if (action < 7 && !expiry.empty()) {
+            auto it = expiry.begin();
+            ::std::advance(it, rng() % expiry.size());
+            CHECK(wheel.Cancel(it->first));
+            auto range = expected.equal_range(it->second);
+            for (auto e = range.first; e != range.second; ++e) {
+                if (e->second == it->first) {
+                    expected.erase(e);
+                    break;
+                }
+            }
+            expiry.erase(it);
+        } else {
+            const int timeout = wheel.NextTimeout();
+            if (expected.empty()) {
+                CHECK_EQ(timeout, -1);
+            } else {
+                CHECK_GE(timeout, 0);
+                CHECK_LE(now + timeout, expected.begin()->first);
+            }
+            now += rng() % 3 == 0 && timeout > 0 ? timeout : rng() % 300;
+            ran.clear();
+            wheel.Advance(now);
+            vector<uint64_t> due;
+            while (!expected.empty() && expected.begin()->first <= now) {
+                due.push_back(expected.begin()->first);
+                expiry.erase(expected.begin()->second);
+                expected.erase(expected.begin());
+            }
+            CHECK(ran == due);
+        }
+        CHECK_EQ(wheel.size(), expected.size());
+    }
+}
+
+}
+
+int main() {
+    TestOrder();
+    TestCancel();
+    TestScheduleFromCallback();
+    TestRandom();
+    printf("timer_wheel_test passed\n");
+    return 0;
+}
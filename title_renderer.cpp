@@ -0,0 +1,314 @@
+#include "title_renderer.h"
+extern "C" {
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+}
+#include <algorithm>
+#include <climits>
+#include <glog/logging.h>
+
+using ::std::string;
+using ::std::vector;
+
+namespace {
+
+// U+2026 HORIZONTAL ELLIPSIS, appended to truncated titles.
+const FcChar32 ELLIPSIS = 0x2026;
+
+XftColor AllocColor(Display *display, int screen, unsigned long rgb) {
+    XRenderColor render_color;
+    render_color.red = ((rgb >> 16) & 0xFF) * 0x101;
+    render_color.green = ((rgb >> 8) & 0xFF) * 0x101;
+    render_color.blue = (rgb & 0xFF) * 0x101;
+    render_color.alpha = 0xFFFF;
+    XftColor color;
+    XftColorAllocValue(
+            display,
+            DefaultVisual(display, screen),
+            DefaultColormap(display, screen),
+            &render_color,
+            &color);
+    return color;
+}
+
+}
+
+vector<FcChar32> DecodeUtf8(const string &s) {
+    vector<FcChar32> out;
+    out.reserve(s.size());
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(s.data());
+    const unsigned char *end = p + s.size();
+    while (p < end) {
+        FcChar32 c;
+        const int len = FcUtf8ToUcs4(p, &c, end - p);
+        if (len <= 0) {
+            out.push_back(0xFFFD);
+            ++p;
+        } else {
+            out.push_back(c);
+            p += len;
+        }
+    }
+    return out;
+}
+
+TitleRenderer::TitleRenderer(Display *display, int screen, const char *font_name)
+    : display_(display),
+      screen_(screen),
+      font_(XftFontOpenName(display, screen, font_name)),
+      draw_(nullptr),
+      gc_(XCreateGC(display, RootWindow(display, screen), 0, nullptr)),
+      foreground_(AllocColor(display, screen, 0xFFFFFF)),
+      background_(0x646375),
+      clock_(0) {
+    if (font_ == nullptr) {
+        LOG(ERROR) << "Failed to open title font " << font_name;
+    }
+    ascii_advances_.fill(-1);
+}
+
+TitleRenderer::~TitleRenderer() {
+    for (auto &cache : caches_) {
+        for (auto &e : cache.entries) {
+            FreeEntry(&e);
+        }
+    }
+    if (draw_ != nullptr) {
+        XftDrawDestroy(draw_);
+    }
+    XftColorFree(
+            display_,
+            DefaultVisual(display_, screen_),
+            DefaultColormap(display_, screen_),
+            &foreground_);
+    if (font_ != nullptr) {
+        XftFontClose(display_, font_);
+    }
+    XFreeGC(display_, gc_);
+}
+
+TitleRenderer::ClientCache &TitleRenderer::Cache(Window client) {
+    const uint32_t *index = clients_.Find(client);
+    if (index != nullptr) {
+        return caches_[*index];
+    }
+    uint32_t slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+    } else {
+        slot = caches_.size();
+        caches_.emplace_back();
+    }
+    clients_.Insert(client, slot);
+    return caches_[slot];
+}
+
+bool TitleRenderer::SetTitle(Window client, const string &title) {
+    ClientCache &cache = Cache(client);
+    if (cache.title == title) {
+        return false;
+    }
+    cache.title = title;
+    return true;
+}
+
+const string &TitleRenderer::Title(Window client) const {
+    static const string empty;
+    const uint32_t *index = clients_.Find(client);
+    return index != nullptr ? caches_[*index].title : empty;
+}
+
+void TitleRenderer::Draw(Window client, Window bar, int width, int height) {
+    if (font_ == nullptr) {
+        return;
+    }
+    ClientCache &cache = Cache(client);
+    const int available = width - kPadding;
+
+    Entry *hit = nullptr;
+    Entry *victim = &cache.entries[0];
+    for (auto &e : cache.entries) {
+        if (e.pixmap != None &&
+            e.title == cache.title &&
+            e.pixmap_height == height &&
+            available >= e.min_width && available < e.max_width) {
+            hit = &e;
+            break;
+        }
+        if (e.last_used < victim->last_used) {
+            victim = &e;
+        }
+    }
+    if (hit == nullptr) {
+        FreeEntry(victim);
+        Render(victim, cache.title, available, height);
+        hit = victim;
+    }
+    hit->last_used = ++clock_;
+
+    XCopyArea(display_, hit->pixmap, bar, gc_,
+              0, 0, hit->pixmap_width, hit->pixmap_height, 0, 0);
+    if (width > hit->pixmap_width) {
+        XClearArea(display_, bar, hit->pixmap_width, 0,
+                   width - hit->pixmap_width, height, false);
+    }
+}
+
+void TitleRenderer::Forget(Window client) {
+    const uint32_t *index = clients_.Find(client);
+    if (index == nullptr) {
+        return;
+    }
+    ClientCache &cache = caches_[*index];
+    for (auto &e : cache.entries) {
+        FreeEntry(&e);
+    }
+    cache.title.clear();
+    free_.push_back(*index);
+    clients_.Erase(client);
+}
+
+void TitleRenderer::SetColors(unsigned long foreground, unsigned long background) {
+    XftColorFree(
+            display_,
+            DefaultVisual(display_, screen_),
+            DefaultColormap(display_, screen_),
+            &foreground_);
+    foreground_ = AllocColor(display_, screen_, foreground);
+    background_ = background;
+    for (auto &cache : caches_) {
+        for (auto &e : cache.entries) {
+            FreeEntry(&e);
+        }
+    }
+}
+
+string TitleRenderer::FetchTitle(Display *display, Window w) {
+    static const Atom NET_WM_NAME = XInternAtom(display, "_NET_WM_NAME", false);
+    static const Atom UTF8_STRING = XInternAtom(display, "UTF8_STRING", false);
+
+    Atom type;
+    int format;
+    unsigned long n_items, bytes_after;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(display, w, NET_WM_NAME, 0, 1024, false, UTF8_STRING,
+                           &type, &format, &n_items, &bytes_after, &data) == Success &&
+        data != nullptr) {
+        string title;
+        if (type == UTF8_STRING && format == 8) {
+            title.assign(reinterpret_cast<char *>(data), n_items);
+        }
+        XFree(data);
+        if (!title.empty()) {
+            return title;
+        }
+    }
+
+    XTextProperty prop;
+    if (!XGetWMName(display, w, &prop) || prop.value == nullptr) {
+        return "";
+    }
+    string title;
+    char **list = nullptr;
+    int count = 0;
+    if (Xutf8TextPropertyToTextList(display, &prop, &list, &count) >= Success &&
+        count > 0 && list != nullptr) {
+        title = list[0];
+        XFreeStringList(list);
+    } else {
+        title.assign(reinterpret_cast<char *>(prop.value), prop.nitems);
+    }
+    XFree(prop.value);
+    return title;
+}
+
+int TitleRenderer::Advance(FcChar32 c) {
+    if (c < ascii_advances_.size() && ascii_advances_[c] >= 0) {
+        return ascii_advances_[c];
+    }
+    auto it = advances_.find(c);
+    if (it != advances_.end()) {
+        return it->second;
+    }
+    XGlyphInfo extents;
+    XftTextExtents32(display_, font_, &c, 1, &extents);
+    if (c < ascii_advances_.size()) {
+        ascii_advances_[c] = extents.xOff;
+    } else {
+        advances_[c] = extents.xOff;
+    }
+    return extents.xOff;
+}
+
+void TitleRenderer::Render(Entry *e, const string &title, int available, int height) {
+    vector<FcChar32> text = DecodeUtf8(title);
+
+    // prefix[i] is the width of the first i glyphs.
+    vector<int> prefix(text.size() + 1, 0);
+    for (size_t i = 0; i < text.size(); ++i) {
+        prefix[i + 1] = prefix[i] + Advance(text[i]);
+    }
+    const int full = prefix.back();
+    const int ellipsis = Advance(ELLIPSIS);
+
+    size_t n;
+    bool truncated;
+    if (full <= available) {
+        n = text.size();
+        truncated = false;
+        e->min_width = full;
+        e->max_width = INT_MAX;
+    } else if (available < ellipsis) {
+        n = 0;
+        truncated = false;
+        e->min_width = INT_MIN;
+        e->max_width = ellipsis;
+    } else {
+        n = ::std::upper_bound(prefix.begin(), prefix.end(), available - ellipsis) -
+            prefix.begin() - 1;
+        truncated = true;
+        e->min_width = prefix[n] + ellipsis;
+        e->max_width = ::std::min(prefix[n + 1] + ellipsis, full);
+    }
+    if (truncated) {
+        text.resize(n);
+        text.push_back(ELLIPSIS);
+    } else {
+        text.resize(n);
+    }
+
+    e->title = title;
+    e->pixmap_width = kPadding + (truncated ? e->min_width : prefix[n]);
+    e->pixmap_height = height;
+    e->pixmap = XCreatePixmap(display_, RootWindow(display_, screen_),
+                              e->pixmap_width, height,
+                              DefaultDepth(display_, screen_));
+    XSetForeground(display_, gc_, background_);
+    XFillRectangle(display_, e->pixmap, gc_, 0, 0, e->pixmap_width, height);
+
+    if (draw_ == nullptr) {
+        draw_ = XftDrawCreate(display_, e->pixmap,
+                              DefaultVisual(display_, screen_),
+                              DefaultColormap(display_, screen_));
+    } else {
+        XftDrawChange(draw_, e->pixmap);
+    }
+    const int baseline = (height + font_->ascent - font_->descent) / 2;
+    XftDrawString32(draw_, &foreground_, font_, kPadding, baseline,
+                    text.data(), text.size());
+}
+
+void TitleRenderer::FreeEntry(Entry *e) {
+    if (e->pixmap != None) {
+        XFreePixmap(display_, e->pixmap);
+    }
+    // The title keeps its buffer for the next render.
+    e->title.clear();
+    e->min_width = 0;
+    e->max_width = 0;
+    e->pixmap = None;
+    e->pixmap_width = 0;
+    e->pixmap_height = 0;
+    e->last_used = 0;
+}
@@ -0,0 +1,104 @@
+#ifndef SIMPLEWM_TITLE_RENDERER_H
+#define SIMPLEWM_TITLE_RENDERER_H
+
+extern "C" {
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+}
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "window_table.h"
+
+// Renders window titles into the title bar with Xft.
+//
+// Glyph advances are cached for the lifetime of the renderer so that laying
+// out a title never goes back to Xft for a character it has already seen.
+// Each client keeps a handful of rendered title pixmaps keyed by the title
+// string; a pixmap stays valid for as long as the available width stays
+// within the truncation breakpoints it was laid out for.
+class TitleRenderer {
+public:
+    TitleRenderer(Display *display, int screen, const char *font_name);
+
+    ~TitleRenderer();
+
+    bool ok() const { return font_ != nullptr; }
+
+    // Records the current title of a client. Returns false if it is unchanged.
+    bool SetTitle(Window client, const ::std::string &title);
+
+    // Returns the last title recorded for a client.
+    const ::std::string &Title(Window client) const;
+
+    // Draws the current title of a client into its title bar, which is
+    // width x height pixels large. Regenerates the title pixmap only on a
+    // cache miss.
+    void Draw(Window client, Window bar, int width, int height);
+
+    // Drops all cached state of a client.
+    void Forget(Window client);
+
+    // Changes the colours used for new renders and drops all pixmaps.
+    void SetColors(unsigned long foreground, unsigned long background);
+
+    // Reads _NET_WM_NAME, falling back to WM_NAME.
+    static ::std::string FetchTitle(Display *display, Window w);
+
+private:
+    // Number of rendered titles kept per client.
+    static const int kEntriesPerClient = 4;
+    // Horizontal padding in front of the title text.
+    static const int kPadding = 6;
+
+    struct Entry {
+        ::std::string title;
+        // Available text widths in [min_width, max_width) produce the same
+        // truncated layout and therefore the same pixmap.
+        int min_width = 0;
+        int max_width = 0;
+        Pixmap pixmap = None;
+        int pixmap_width = 0;
+        int pixmap_height = 0;
+        uint64_t last_used = 0;
+    };
+
+    struct ClientCache {
+        ::std::string title;
+        ::std::array<Entry, kEntriesPerClient> entries;
+    };
+
+    // Returns the cache of a client, creating it on first use.
+    ClientCache &Cache(Window client);
+
+    // Returns the advance of a glyph, caching it on first use.
+    int Advance(FcChar32 c);
+
+    // Lays out title into at most available pixels and renders it into e.
+    void Render(Entry *e, const ::std::string &title, int available, int height);
+
+    void FreeEntry(Entry *e);
+
+    Display *display_;
+    const int screen_;
+    XftFont *font_;
+    XftDraw *draw_;
+    GC gc_;
+    XftColor foreground_;
+    unsigned long background_;
+    uint64_t clock_;
+
+    ::std::array<int16_t, 128> ascii_advances_;
+    ::std::unordered_map<FcChar32, int> advances_;
+    // Caches of forgotten clients are reused along with their strings.
+    ::std::vector<ClientCache> caches_;
+    ::std::vector<uint32_t> free_;
+    WindowMap<uint32_t> clients_;
+};
+
+// Decodes UTF-8 into code points, replacing malformed sequences with U+FFFD.
+::std::vector<FcChar32> DecodeUtf8(const ::std::string &s);
+
+#endif
@@ -27,7 +27,7 @@ using ::std::vector;
 using ::std::pair;
 using ::std::ostringstream;
 
-string ToString(const XEvent& e) {
+string XEventTypeToString(int type) {
     static const char* const X_EVENT_TYPE_NAMES[] = {
             "",
             "",
@@ -67,11 +67,18 @@ string ToString(const XEvent& e) {
             "GeneralEvent",
     };
 
-    if (e.type < 2 || e.type >= LASTEvent) {
+    if (type < 2 || type >= LASTEvent) {
         ostringstream out;
-        out << "Unknown (" << e.type << ")";
+        out << "Unknown (" << type << ")";
         return out.str();
     }
+    return X_EVENT_TYPE_NAMES[type];
+}
+
+string ToString(const XEvent& e) {
+    if (e.type < 2 || e.type >= LASTEvent) {
+        return XEventTypeToString(e.type);
+    }
 
     // 1. Compile properties we care about.
     vector<pair<string, string>> properties;
@@ -189,6 +196,14 @@ string ToString(const XEvent& e) {
             properties.emplace_back(
                     "time", ToString(e.xmotion.time));
             break;
+        case PropertyNotify:
+            properties.emplace_back(
+                    "window", ToString(e.xproperty.window));
+            properties.emplace_back(
+                    "atom", ToString(e.xproperty.atom));
+            properties.emplace_back(
+                    "state", ToString(e.xproperty.state));
+            break;
         case KeyPress:
         case KeyRelease:
             properties.emplace_back(
@@ -209,7 +224,7 @@ string ToString(const XEvent& e) {
                 return pair.first + ": " + pair.second;
             });
     ostringstream out;
-    out << X_EVENT_TYPE_NAMES[e.type] << " { " << properties_string << " }";
+    out << XEventTypeToString(e.type) << " { " << properties_string << " }";
     return out.str();
 }
 
@@ -363,5 +378,9 @@ string XRequestCodeToString(unsigned char request_code) {
             "GetModifierMapping",
             "NoOperation",
     };
+    // Codes from 128 on are assigned to extensions by the server.
+    if (request_code >= sizeof(X_REQUEST_CODE_NAMES) / sizeof(X_REQUEST_CODE_NAMES[0])) {
+        return "extension request " + ToString(static_cast<int>(request_code));
+    }
     return X_REQUEST_CODE_NAMES[request_code];
 }
\ No newline at end of file
@@ -22,6 +22,7 @@
 extern "C" {
 #include <X11/Xlib.h>
 }
+#include <algorithm>
 #include <ostream>
 #include <string>
 
@@ -31,7 +32,7 @@ struct Size {
     T width, height;
 
     Size() = default;
-    Size(T w, T h)
+    constexpr Size(T w, T h)
             : width(w), height(h) {
     }
 
@@ -49,7 +50,7 @@ struct Position {
     T x, y;
 
     Position() = default;
-    Position(T _x, T _y)
+    constexpr Position(T _x, T _y)
             : x(_x), y(_y) {
     }
 
@@ -73,6 +74,72 @@ struct Vector2D {
 template <typename T>
 ::std::ostream& operator << (::std::ostream& out, const Position<T>& pos);
 
+// Represents an axis-aligned rectangle covering [x, right()) x [y, bottom()).
+// It is empty if its width or height is not positive.
+template <typename T>
+struct Rect {
+    T x, y;
+    T width, height;
+
+    static constexpr Rect FromEdges(T left, T top, T right, T bottom) {
+        return Rect{left, top, right - left, bottom - top};
+    }
+
+    constexpr T right() const { return x + width; }
+    constexpr T bottom() const { return y + height; }
+    constexpr bool empty() const { return width <= 0 || height <= 0; }
+    constexpr Position<T> center() const { return Position<T>(x + width / 2, y + height / 2); }
+
+    constexpr bool Contains(T px, T py) const {
+        return px >= x && px < right() && py >= y && py < bottom();
+    }
+
+    constexpr bool Contains(const Rect &o) const {
+        return o.x >= x && o.right() <= right() && o.y >= y && o.bottom() <= bottom();
+    }
+
+    constexpr bool Intersects(const Rect &o) const {
+        return x < o.right() && o.x < right() && y < o.bottom() && o.y < bottom();
+    }
+
+    // Returns the overlap with o, which has no area if there is none.
+    constexpr Rect Intersect(const Rect &o) const {
+        return Rect{::std::max(x, o.x), ::std::max(y, o.y),
+                    ::std::max(T(0), ::std::min(right(), o.right()) - ::std::max(x, o.x)),
+                    ::std::max(T(0), ::std::min(bottom(), o.bottom()) - ::std::max(y, o.y))};
+    }
+
+    // Returns the smallest rectangle covering both.
+    constexpr Rect Bound(const Rect &o) const {
+        return FromEdges(::std::min(x, o.x), ::std::min(y, o.y),
+                         ::std::max(right(), o.right()), ::std::max(bottom(), o.bottom()));
+    }
+
+    constexpr Rect Translate(T dx, T dy) const { return Rect{x + dx, y + dy, width, height}; }
+
+    // Returns the rectangle grown by dw and dh, keeping its origin.
+    constexpr Rect Inflate(T dw, T dh) const { return Rect{x, y, width + dw, height + dh}; }
+
+    // Returns the rectangle moved as little as possible to lie inside area,
+    // or to its top left corner if it does not fit.
+    constexpr Rect ClampInto(const Rect &area) const {
+        return Rect{::std::max(area.x, ::std::min(x, area.right() - width)),
+                    ::std::max(area.y, ::std::min(y, area.bottom() - height)),
+                    width, height};
+    }
+
+    constexpr bool operator == (const Rect &o) const {
+        return x == o.x && y == o.y && width == o.width && height == o.height;
+    }
+    constexpr bool operator != (const Rect &o) const { return !(*this == o); }
+
+    ::std::string ToString() const;
+};
+
+// Outputs a Rect<T> as a string to a std::ostream.
+template <typename T>
+::std::ostream& operator << (::std::ostream& out, const Rect<T>& rect);
+
 // Position operators.
 template <typename T>
 Vector2D<T> operator - (const Position<T>& a, const Position<T>& b);
@@ -113,13 +180,17 @@ template <typename Container, typename Converter>
 template <typename T>
 ::std::string ToString(const T& x);
 
+// Returns the name of an X event type.
+extern ::std::string XEventTypeToString(int type);
+
 // Returns a string describing an X event for debugging purposes.
 extern ::std::string ToString(const XEvent& e);
 
 // Returns a string describing an X window configuration value mask.
 extern ::std::string XConfigureWindowValueMaskToString(unsigned long value_mask);
 
-// Returns the name of an X request code.
+// Returns the name of a core X request code. Extension requests, which
+// need the opcodes of the display to be named, are only numbered.
 extern ::std::string XRequestCodeToString(unsigned char request_code);
 
 
@@ -166,6 +237,18 @@ template <typename T>
     return out << size.ToString();
 }
 
+template <typename T>
+::std::string Rect<T>::ToString() const {
+    ::std::ostringstream out;
+    out << width << 'x' << height << (x < 0 ? "" : "+") << x << (y < 0 ? "" : "+") << y;
+    return out.str();
+}
+
+template <typename T>
+::std::ostream& operator << (::std::ostream& out, const Rect<T>& rect) {
+    return out << rect.ToString();
+}
+
 template <typename T>
 Vector2D<T> operator - (const Position<T>& a, const Position<T>& b) {
     return Vector2D<T>(a.x - b.x, a.y - b.y);
@@ -1,13 +1,24 @@
 #include "window_manager.h"
 extern "C" {
+#include <X11/Xatom.h>
+#include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/XInput2.h>
 #include <X11/extensions/shape.h>
 #include <X11/cursorfont.h>
 #include <X11/xpm.h>
 }
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <array>
+#include <sstream>
 #include <glog/logging.h>
+#include "flight_recorder.h"
+#include "placement.h"
+#include "snap.h"
 #include "util.h"
 #include <mutex>
 
@@ -17,63 +28,109 @@ using ::std::mutex;
 using ::std::string;
 using ::std::unique_ptr;
 
+namespace {
+
+const int BORDERWIDTH = 1;
+
+// Layout of _SIMPLEWM_STATE: the version and the current workspace, then
+// STATE_FIELDS values per client from the bottom of the stack to the top.
+const long STATE_VERSION = 2;
+const size_t STATE_FIELDS = 17;
+
+// Space between the thumbnails of the overview.
+const int OVERVIEW_GAP = 24;
+
+// Longest chain of WM_TRANSIENT_FOR followed, which also ends cycles.
+const int MAX_TRANSIENT_DEPTH = 16;
+
+// Returns the windows of a client that map to its record in windows_.
+::std::array<Window, 6> clientWindows(const ClientWin &win) {
+    return {{win.w, win.frame, win.topBar.win, win.topBar.closeIcon,
+             win.topBar.maximizeIcon, win.topBar.minimizeIcon}};
+}
+
+}
+
 bool WindowManager::wm_detected_;
 mutex WindowManager::wm_detected_mutex_;
+ErrorTracker WindowManager::errors_;
 
-unique_ptr<WindowManager> WindowManager::Create() {
+unique_ptr<WindowManager> WindowManager::Create(const Config &config) {
     Display *display = XOpenDisplay(nullptr);
     if (display == nullptr) {
         LOG(ERROR) << "Failed to open X display" << XDisplayName(nullptr);
         return nullptr;
     }
-    return unique_ptr<WindowManager>(new WindowManager(display));
+    return unique_ptr<WindowManager>(new WindowManager(display, config));
 }
 
-WindowManager::WindowManager(Display *display)
+WindowManager::WindowManager(Display *display, const Config &config)
     : display_(CHECK_NOTNULL(display)),
       root_(DefaultRootWindow(display)),
+      bg(),
+      baseConfig_(config),
+      config_(::std::make_shared<const Config>(config)),
+      outputs_(display),
+      shapes_(display, 64),
+      timers_(TimerWheel::Now()),
+      paintTimer_(0),
+      pingTimer_(0),
+      lastPaint_(0),
+      pingSerial_(0),
+      restarting_(false),
+      focusTimer_(0),
+      currentWorkspace_(0),
+      drag_(),
+      xiOpcode_(-1),
+      overviewShown_(false),
       WM_PROTOCOLS(XInternAtom(display_, "WM_PROTOCOLS", false)),
-      WM_DELETE_WINDOW(XInternAtom(display_, "WM_DELETE_WINDOW", false)) {
+      WM_DELETE_WINDOW(XInternAtom(display_, "WM_DELETE_WINDOW", false)),
+      NET_WM_NAME(XInternAtom(display_, "_NET_WM_NAME", false)),
+      NET_WM_PING(XInternAtom(display_, "_NET_WM_PING", false)),
+      SIMPLEWM_STATE(XInternAtom(display_, "_SIMPLEWM_STATE", false)),
+      SIMPLEWM_FRAME(XInternAtom(display_, "_SIMPLEWM_FRAME", false)),
+      WM_WINDOW_ROLE(XInternAtom(display_, "WM_WINDOW_ROLE", false)),
+      WM_STATE(XInternAtom(display_, "WM_STATE", false)),
+      WM_CHANGE_STATE(XInternAtom(display_, "WM_CHANGE_STATE", false)) {
+    titles_.reset(new TitleRenderer(display_, DefaultScreen(display_), "sans-10"));
 }
 
 WindowManager::~WindowManager() {
+    // These free their server resources through the connection. Everything
+    // but the frames and decorations is freed explicitly, as saveState()
+    // has the server retain what the connection leaves behind.
+    compositor_.reset();
+    titles_.reset();
+    session_.reset();
+    forEachClient([this](ClientWin &win) {
+        XFreeGC(display_, win.topBar.closeGC);
+    });
+    if (bg.pixmap != None)
+        XFreePixmap(display_, bg.pixmap);
     XCloseDisplay(display_);
 }
 
-bool isTopBar(::std::vector<ClientWin> clients, Window eWin) {
-    for (auto & client : clients) {
-        if (client.topBar.win == eWin)
-            return true;
-    }
-    return false;
-}
-
-bool isCloseIcon(::std::vector<ClientWin> clients, Window eWin) {
-    for (auto & client : clients) {
-        if (client.topBar.closeIcon == eWin)
-            return true;
-    }
-    return false;
-}
-
-ClientWin getWin(::std::vector<ClientWin> clients, Window frame) {
-    for (auto & win : clients) {
-        if (win.frame == frame) {
-            return win;
-        }
-    }
-    ClientWin ret;
-    return ret;
+bool WindowManager::supportsProtocol(Window w, Atom protocol) {
+    Atom* supportedProtocols;
+    int numSupportedProtocols;
+    if (!XGetWMProtocols(display_, w, &supportedProtocols, &numSupportedProtocols))
+        return false;
+    const bool supported =
+        ::std::find(supportedProtocols, supportedProtocols+numSupportedProtocols, protocol) !=
+        supportedProtocols + numSupportedProtocols;
+    XFree(supportedProtocols);
+    return supported;
 }
 
 void WindowManager::closeWindow(Window win) {
     /*XDestroyWindow(display_, win);
     LOG(INFO) << "Destroyed Window " << win;*/
-    Atom* supportedProtocols;
-    int numSupportedProtocols;
-    if (XGetWMProtocols(display_, win, &supportedProtocols, &numSupportedProtocols) &&
-        ::std::find(supportedProtocols, supportedProtocols+numSupportedProtocols, WM_DELETE_WINDOW) !=
-        supportedProtocols + numSupportedProtocols) {
+    // Accept frames and decorations as well, e.g. from the alt + f4 grab.
+    const Handle handle = windows_.Find(win);
+    ClientWin *client = clients_.Get(handle);
+    if (client != nullptr)
+        win = client->w;
+    if (supportsProtocol(win, WM_DELETE_WINDOW)) {
         LOG(INFO) << "Gracefully deleting window " << win;
 
         XEvent msg;
@@ -83,15 +140,23 @@ void WindowManager::closeWindow(Window win) {
         msg.xclient.window = win;
         msg.xclient.format = 32;
         msg.xclient.data.l[0] = WM_DELETE_WINDOW;
+        recordRequest(X_SendEvent, win, WM_DELETE_WINDOW);
         CHECK(XSendEvent(display_, win, false, 0, &msg));
+
+        // A client that hangs instead of closing is killed.
+        if (client != nullptr && client->ping.supported) {
+            client->ping.closing = true;
+            sendPing(handle);
+        }
     } else {
         LOG(INFO) << "Killing Window " << win;
+        recordRequest(X_DestroyWindow, win);
         XDestroyWindow(display_, win);
     }
 }
 
-void WindowManager::drawCross(ClientWin win) {
-    unsigned long color = 0x646375;
+void WindowManager::drawCross(const ClientWin &win) {
+    const unsigned long color = config_->title_color;
     LOG(INFO) << "GC: " << win.topBar.closeGC;
     XSetForeground(display_, win.topBar.closeGC, 0xFF0000);
     XSetBackground(display_, win.topBar.closeGC, color);
@@ -103,20 +168,108 @@ void WindowManager::drawCross(ClientWin win) {
     XDrawLine(display_, win.topBar.closeIcon, win.topBar.closeGC, 6, 14, 14, 6);
 }
 
+void WindowManager::drawIcons(const ClientWin &win) {
+    const unsigned long color = config_->title_color;
+    drawCross(win);
+    XSetForeground(display_, win.topBar.closeGC, 0xFFFFFF);
+    XSetLineAttributes(display_, win.topBar.closeGC, 2, LineSolid, CapRound, JoinRound);
+    XSetWindowBackground(display_, win.topBar.maximizeIcon, color);
+    XClearWindow(display_, win.topBar.maximizeIcon);
+    XDrawRectangle(display_, win.topBar.maximizeIcon, win.topBar.closeGC, 5, 5, 10, 10);
+    if (win.maximized)
+        XDrawRectangle(display_, win.topBar.maximizeIcon, win.topBar.closeGC, 8, 8, 4, 4);
+    XSetWindowBackground(display_, win.topBar.minimizeIcon, color);
+    XClearWindow(display_, win.topBar.minimizeIcon);
+    XDrawLine(display_, win.topBar.minimizeIcon, win.topBar.closeGC, 5, 14, 15, 14);
+}
+
+void WindowManager::drawTitle(const ClientWin &win) {
+    // The minimize, maximize and close icons occupy the right end of the
+    // title bar.
+    const int textWidth = static_cast<int>(win.topBar.width) - 72;
+    if (textWidth > 0) {
+        titles_->Draw(win.w, win.topBar.win, textWidth, config_->title_height);
+    }
+}
+
+void WindowManager::fetchClass(Window w, string *instance, string *wm_class) {
+    XClassHint hint;
+    if (!XGetClassHint(display_, w, &hint))
+        return;
+    if (hint.res_name != nullptr)
+        *instance = hint.res_name;
+    if (hint.res_class != nullptr)
+        *wm_class = hint.res_class;
+    XFree(hint.res_name);
+    XFree(hint.res_class);
+}
+
+uint64_t WindowManager::sessionKey(Window w, const string &instance, const string &wm_class) {
+    if (instance.empty() && wm_class.empty())
+        return 0;
+    string role;
+    XTextProperty prop;
+    if (XGetTextProperty(display_, w, &prop, WM_WINDOW_ROLE) && prop.value != nullptr) {
+        role.assign(reinterpret_cast<char *>(prop.value), prop.nitems);
+        XFree(prop.value);
+    }
+    return SessionStore::Key(instance + '.' + wm_class, role);
+}
+
+void WindowManager::applyRuleGeometry(const WindowRule &rule, int title_height, Box *outer) {
+    if (rule.fields & WindowRule::SIZE) {
+        *outer = Box{outer->x, outer->y, static_cast<int>(rule.width), static_cast<int>(rule.height)}
+                         .Inflate(2 * BORDERWIDTH, title_height + 2 * BORDERWIDTH);
+    }
+    if (rule.fields & WindowRule::POSITION) {
+        const Box area = outputs_.WorkArea(lastPointer_.x, lastPointer_.y);
+        outer->x = rule.x_negative ? area.right() - outer->width + rule.x : area.x + rule.x;
+        outer->y = rule.y_negative ? area.bottom() - outer->height + rule.y : area.y + rule.y;
+    }
+}
+
+bool WindowManager::restoreGeometry(uint64_t key, Box *outer) {
+    if (!session_ || key == 0 || !session_->Lookup(key, outer))
+        return false;
+    // Further windows of the same kind are placed as usual instead of
+    // stacking up exactly on top of the first one.
+    bool taken = false;
+    forEachClient([key, &taken](ClientWin &win) {
+        taken = taken || win.sessionKey == key;
+    });
+    if (taken)
+        return false;
+    // The output it was on may be gone.
+    const Position<int> center = outer->center();
+    return outputs_.At(center.x, center.y).area.Contains(center.x, center.y) &&
+           outer->width > 2 && outer->height > 28;
+}
+
+bool WindowManager::hasRequestedPosition(Window w) {
+    XSizeHints hints;
+    long supplied;
+    if (!XGetWMNormalHints(display_, w, &hints, &supplied))
+        return false;
+    return hints.flags & (USPosition | PPosition);
+}
+
 void WindowManager::setBackground(const char *path) {
     LOG(INFO) << "Creating XPM Pixmap";
     bg.path = path;
     Pixmap tmp;
     XWindowAttributes attrs;
     XGetWindowAttributes(display_, root_, &attrs);
-    XpmReadFileToPixmap(display_, root_, bg.path, &bg.pixmap, nullptr, nullptr);
+    if (XpmReadFileToPixmap(display_, root_, bg.path, &bg.pixmap, nullptr, nullptr) != XpmSuccess)
+        LOG(ERROR) << "Failed to read wallpaper " << bg.path;
 }
 
 void WindowManager::Run() {
     wm_detected_ = false;
     XSetErrorHandler(&WindowManager::OnWMDetected);
 
-    setBackground("./resources/LinusTorvalds.xpm");
+    config_ = readConfig();
+    titles_->SetColors(0xFFFFFF, config_->title_color);
+    setBackground(config_->wallpaper.c_str());
     XClearWindow(display_, root_);
     XSetWindowBackgroundPixmap(display_, root_, bg.pixmap);
 
@@ -130,6 +283,42 @@ void WindowManager::Run() {
         return;
     }
     XSetErrorHandler(&WindowManager::OnXError);
+    errors_.NameExtensions(display_);
+
+    outputs_.Init(root_);
+    {
+        int event, error, major = 2, minor = 0;
+        if (XQueryExtension(display_, "XInputExtension", &xiOpcode_, &event, &error) &&
+            XIQueryVersion(display_, &major, &minor) == Success) {
+            LOG(INFO) << "XInput " << major << "." << minor;
+        } else {
+            xiOpcode_ = -1;
+        }
+    }
+    {
+        Window returned_root, returned_child;
+        int x, y, win_x, win_y;
+        unsigned int mask;
+        if (XQueryPointer(display_, root_, &returned_root, &returned_child,
+                          &x, &y, &win_x, &win_y, &mask)) {
+            lastPointer_ = Position<int>(x, y);
+        } else {
+            const Box &primary = outputs_.Primary().area;
+            lastPointer_ = Position<int>(primary.x, primary.y);
+        }
+    }
+
+    if (config_->restore_session)
+        session_.reset(new SessionStore(SessionPath()));
+    rules_ = WindowRules(RulesPath());
+
+    if (config_->compositing) {
+        compositor_.reset(new Compositor(display_, root_));
+        if (!compositor_->Init(bg.pixmap)) {
+            LOG(ERROR) << "Compositing disabled";
+            compositor_.reset();
+        }
+    }
 
     XGrabServer(display_);
     Window returned_root, returned_parent;
@@ -143,74 +332,149 @@ void WindowManager::Run() {
             &top_level_windows,
             &num_top_level_windows));
     CHECK_EQ(returned_root, root_);
+    adoptState();
     for (int i = 0; i < num_top_level_windows; ++i) {
-        Frame(top_level_windows[i], true);
+        Window w = top_level_windows[i];
+        if (windows_.Find(w))
+            continue;
+        const Window orphan = releaseStaleFrame(w);
+        Frame(orphan != None ? orphan : w, true);
     }
 
     XFree(top_level_windows);
     XUngrabServer(display_);
 
+    // The root window keeps the cursor alive.
     Cursor c = XCreateFontCursor(display_, XC_arrow);
     XDefineCursor(display_, root_, c);
+    XFreeCursor(display_, c);
 
+    if (config_->ping_interval_ms > 0)
+        pingTimer_ = timers_.Schedule(config_->ping_interval_ms, [this]() { pingAll(); });
 
 
-    while(true) {
-        //Get the next Event
-        XEvent e;
-        XNextEvent(display_, &e);
-        LOG(INFO) << "Received event: " << ToString(e);
 
-        switch(e.type) {
-            case CreateNotify:
-                OnCreateNotify(e.xcreatewindow);
-                break;
-            case DestroyNotify:
-                OnDestroyNotify(e.xdestroywindow);
-                break;
-            case ReparentNotify:
-                OnReparentNotify(e.xreparent);
-                break;
-            case MapNotify:
-                OnMapNotify(e.xmap);
-                break;
-            case UnmapNotify:
-                OnUnmapNotify(e.xunmap);
-                break;
-            case ConfigureNotify:
-                OnConfigureNotify(e.xconfigure);
-                break;
-            case MapRequest:
-                OnMapRequest(e.xmaprequest);
-                break;
-            case ConfigureRequest:
-                OnConfigureRequest(e.xconfigurerequest);
-                break;
-            case ButtonPress:
-                OnButtonPress(e.xbutton);
-                break;
-            case ButtonRelease:
-                OnButtonRelease(e.xbutton);
-                break;
-            case MotionNotify:
-                OnMotionNotify(e.xmotion);
-                break;
-            case KeyPress:
-                OnKeyPress(e.xkey);
-                break;
-            case KeyRelease:
-                OnKeyRelease(e.xkey);
-                break;
-            case Expose:
-                XClearWindow(display_, root_);
-                XSetWindowBackgroundPixmap(display_, root_, bg.pixmap);
-                for (auto & clientWin : clientWindows) {
-                    drawCross(clientWin);
-                }
-                break;
-            default:
-                LOG(WARNING) << "Event not handled";
+    ipc_.Listen(IpcSocketPath());
+    watcher_.Watch(ConfigPath());
+    watcher_.Watch(RulesPath());
+
+    // Setting up may have taken a while; timers count from now.
+    timers_.Advance(TimerWheel::Now());
+    ::std::vector<pollfd> fds;
+    while(!restarting_) {
+        while (XPending(display_)) {
+            //Get the next Event
+            XEvent e;
+            XNextEvent(display_, &e);
+            HandleEvent(e);
+        }
+        errors_.Dispatch(LastKnownRequestProcessed(display_),
+                         [this](const ErrorTracker::Failure &f) { onRequestFailed(f); });
+        applyDrag();
+        timers_.Advance(TimerWheel::Now());
+        // Composite once all pending events have been handled.
+        schedulePaint();
+        XFlush(display_);
+
+        fds.clear();
+        fds.push_back(pollfd{ConnectionNumber(display_), POLLIN, 0});
+        ipc_.AddPollFds(&fds);
+        watcher_.AddPollFds(&fds);
+        // Painting, drags and timers may have read events into Xlib's queue,
+        // where poll() cannot see them. Without those or pending timers this
+        // blocks until there is input.
+        const int timeout = XEventsQueued(display_, QueuedAlready) > 0 ? 0 : timers_.NextTimeout();
+        const int ready = poll(fds.data(), fds.size(), timeout);
+        // Timers scheduled by the handlers count from when poll() returned,
+        // not from before it blocked.
+        timers_.Advance(TimerWheel::Now());
+        if (ready < 0) {
+            if (errno != EINTR)
+                PLOG(FATAL) << "poll";
+            continue;
         }
+        // A whole batch of commands is applied before the next flush.
+        ipc_.Dispatch(fds, [this](const ::std::vector<string> &commands) {
+            return RunCommands(commands);
+        });
+        watcher_.Dispatch(fds, [this](const string &path) {
+            if (path == ConfigPath()) {
+                reloadConfig();
+            } else {
+                rules_ = WindowRules(path);
+            }
+        });
+    }
+    saveState();
+}
+
+void WindowManager::HandleEvent(XEvent &e) {
+    FlightRecorder::RecordEvent(e);
+    VLOG(1) << "Received event: " << ToString(e);
+
+    if (compositor_ && compositor_->HandleEvent(e))
+        return;
+
+    switch(e.type) {
+        case CreateNotify:
+            OnCreateNotify(e.xcreatewindow);
+            break;
+        case DestroyNotify:
+            OnDestroyNotify(e.xdestroywindow);
+            break;
+        case ReparentNotify:
+            OnReparentNotify(e.xreparent);
+            break;
+        case MapNotify:
+            OnMapNotify(e.xmap);
+            break;
+        case UnmapNotify:
+            OnUnmapNotify(e.xunmap);
+            break;
+        case ConfigureNotify:
+            OnConfigureNotify(e.xconfigure);
+            break;
+        case MapRequest:
+            OnMapRequest(e.xmaprequest);
+            break;
+        case ConfigureRequest:
+            OnConfigureRequest(e.xconfigurerequest);
+            break;
+        case ButtonPress:
+            OnButtonPress(e.xbutton);
+            break;
+        case ButtonRelease:
+            OnButtonRelease(e.xbutton);
+            break;
+        case MotionNotify:
+            OnMotionNotify(e.xmotion);
+            break;
+        case GenericEvent:
+            OnGenericEvent(e.xcookie);
+            break;
+        case KeyPress:
+            OnKeyPress(e.xkey);
+            break;
+        case KeyRelease:
+            OnKeyRelease(e.xkey);
+            break;
+        case EnterNotify:
+            OnEnterNotify(e.xcrossing);
+            break;
+        case PropertyNotify:
+            OnPropertyNotify(e.xproperty);
+            break;
+        case Expose:
+            OnExpose(e.xexpose);
+            break;
+        case ClientMessage:
+            OnClientMessage(e.xclient);
+            break;
+        default:
+            if (outputs_.IsScreenChangeEvent(&e))
+                OnScreenChange();
+            else
+                LOG(WARNING) << "Event not handled";
     }
 }
 
@@ -221,12 +485,17 @@ int WindowManager::OnWMDetected(Display *display, XErrorEvent *e) {
 }
 
 int WindowManager::OnXError(Display *display, XErrorEvent *e) {
+    FlightRecorder::Record(FlightRecord::ERROR, e->error_code, e->request_code,
+                           e->serial, e->resourceid, e->minor_code);
+    // Errors of tracked operations are handled from the main loop.
+    if (errors_.Report(*e))
+        return 0;
     const int MAX_ERROR_TEXT_LENGTH = 1024;
     char error_text[MAX_ERROR_TEXT_LENGTH];
     XGetErrorText(display, e->error_code, error_text, sizeof(error_text));
     LOG(ERROR) << "Received X error:\n"
                << "    Request: " << int(e->request_code)
-               << " - " << XRequestCodeToString(e->request_code) << "\n"
+               << " - " << errors_.RequestName(e->request_code, e->minor_code) << "\n"
                << "    Error code: " << int(e->error_code)
                << " - " << error_text << "\n"
                << "    Resource ID: " << e->resourceid;
@@ -235,16 +504,14 @@ int WindowManager::OnXError(Display *display, XErrorEvent *e) {
 }
 
 void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
-    ClientWin client;
-    const int BORDERWIDTH = 1;
-    const unsigned int BORDERCOLOR = 0x7a7a7a;
-    const unsigned int BGCOLOR = 0x3b414a;
+    CHECK(!windows_.Find(w));
+    ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::FRAME, w);
 
-    CHECK(!clients_.count(w));
-
-    client.w = w;
     XWindowAttributes x_window_attrs;
-    CHECK(XGetWindowAttributes(display_, w, &x_window_attrs));
+    if (!XGetWindowAttributes(display_, w, &x_window_attrs)) {
+        LOG(INFO) << "Window " << w << " is gone before it was framed";
+        return;
+    }
 
     if (was_created_before_window_manager) {
         if(x_window_attrs.override_redirect || x_window_attrs.map_state != IsViewable) {
@@ -253,24 +520,104 @@ void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
         }
     }
 
+    const Handle handle = clients_.Allocate();
+    ClientWin &client = *clients_.Get(handle);
+    client.w = w;
+    client.workspace = currentWorkspace_;
+    fetchGroupHints(client);
+    const ClientWin *parent = clientFor(client.transientFor);
+    if (parent != nullptr && parent->w != client.transientFor)
+        parent = nullptr;
+    if (parent != nullptr)
+        client.workspace = parent->workspace;
+
+    string instance, wm_class;
+    fetchClass(w, &instance, &wm_class);
+    // Dialogs share the class of their main window and are placed over it
+    // rather than where they were last time.
+    client.sessionKey = client.transientFor == None ? sessionKey(w, instance, wm_class) : 0;
+    // Rules are applied before anything is created, so that no window is
+    // first shown and then moved.
+    WindowRule rule;
+    rules_.Match(instance, wm_class, &rule);
+    if (rule.fields & WindowRule::WORKSPACE)
+        client.workspace = rule.workspace;
+    if (rule.fields & WindowRule::DECORATIONS)
+        client.undecorated = !rule.decorated;
+    const int title_height = titleHeight(client);
+
+    // Frame decorations around the client.
+    const int extra_width = 2 * BORDERWIDTH;
+    const int extra_height = title_height + 2 * BORDERWIDTH;
+    const Box requested = Box{x_window_attrs.x, x_window_attrs.y,
+                              x_window_attrs.width, x_window_attrs.height}
+                                  .Inflate(extra_width, extra_height);
+    Box outer = requested;
+    // A rule's geometry wins over the remembered one, which wins over
+    // placement. Transients are centred over their parent instead.
+    bool positioned = rule.fields & WindowRule::POSITION;
+    Box remembered;
+    Box parent_outer;
+    if (rule.fields & (WindowRule::POSITION | WindowRule::SIZE)) {
+        applyRuleGeometry(rule, title_height, &outer);
+    } else if (restoreGeometry(client.sessionKey, &remembered)) {
+        outer = remembered;
+        positioned = true;
+    }
+    if (!positioned && !was_created_before_window_manager && !hasRequestedPosition(w)) {
+        if (parent != nullptr && frames_.Get(parent->frame, &parent_outer)) {
+            const Position<int> center = parent_outer.center();
+            outer.x = center.x - outer.width / 2;
+            outer.y = center.y - outer.height / 2;
+            outer = outer.ClampInto(outputs_.WorkArea(center.x, center.y));
+        } else {
+            ::std::vector<Box> occupied;
+            frames_.All(&occupied);
+            const Position<int> placed = PlaceLeastOverlap(
+                    outputs_.WorkArea(lastPointer_.x, lastPointer_.y),
+                    outer.width, outer.height, occupied);
+            outer.x = placed.x;
+            outer.y = placed.y;
+        }
+    }
+    if (outer.width != requested.width || outer.height != requested.height) {
+        // Sized before it is reparented, so the frame is created in place.
+        x_window_attrs.width = outer.width - extra_width;
+        x_window_attrs.height = outer.height - extra_height;
+        XResizeWindow(display_, w, x_window_attrs.width, x_window_attrs.height);
+    }
+
     client.frame = XCreateSimpleWindow(
             display_,
             root_,
-            x_window_attrs.x,
-            x_window_attrs.y,
+            outer.x,
+            outer.y,
             x_window_attrs.width,
-            x_window_attrs.height + 26,
+            x_window_attrs.height + title_height,
             BORDERWIDTH,
-            BORDERCOLOR,
-            BGCOLOR);
+            config_->border_color,
+            config_->frame_color);
+    frames_.Update(client.frame, outer);
+    if (session_ && client.sessionKey != 0)
+        session_->Remember(client.sessionKey, outer);
+    // Lets a later instance find clients left in the frame if this one dies.
+    const long marker = w;
+    XChangeProperty(display_, client.frame, SIMPLEWM_FRAME, XA_WINDOW, 32, PropModeReplace,
+                    reinterpret_cast<const unsigned char *>(&marker), 1);
+    if (compositor_)
+        compositor_->Decorate(client.frame, config_->frame_opacity, config_->shadows);
     XSetWindowBorderWidth(display_, w, 0);
-    //Pixmap pixmap = XCreatePixmap(display_, client.frame, 400, 300, 1);
-    //XShapeCombineMask(display_, client.frame, ShapeBounding, 0, 0, pixmap, ShapeSet);     //TODO transparent frame
+    shapes_.Apply(client.frame, outer.width, outer.height, BORDERWIDTH, config_->frame_radius,
+                  config_->see_through_border);
 
-    XSelectInput(display_, client.frame, SubstructureRedirectMask | SubstructureNotifyMask);
+    XSelectInput(display_, client.frame, frameEventMask());
     XAddToSaveSet(display_, w);
-    XReparentWindow(display_, w, client.frame, 0, 26);
-    XMapWindow(display_, client.frame);
+    recordRequest(X_ReparentWindow, w, client.frame);
+    XReparentWindow(display_, w, client.frame, 0, title_height);
+    if (client.workspace == currentWorkspace_)
+        XMapWindow(display_, client.frame);
+    else
+        frames_.SetMapped(client.frame, false);
 
     //Create Titlebar
     client.topBar.win = XCreateSimpleWindow(
@@ -279,13 +626,18 @@ void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
             x_window_attrs.x,
             x_window_attrs.y,
             x_window_attrs.width,
-            26,
+            config_->title_height,
             0,
             0,
-            0x646375);
-    XSelectInput(display_, client.topBar.win, SubstructureRedirectMask | SubstructureNotifyMask);
+            config_->title_color);
+    client.topBar.width = x_window_attrs.width;
+    XSelectInput(display_, client.topBar.win, SubstructureRedirectMask | SubstructureNotifyMask | ExposureMask);
     XReparentWindow(display_, client.topBar.win, client.frame, 0, 0);
-    XMapWindow(display_, client.topBar.win);
+
+    XSelectInput(display_, w, PropertyChangeMask);
+    outputs_.UpdateStrut(w);
+    titles_->SetTitle(w, TitleRenderer::FetchTitle(display_, w));
+    client.ping.supported = supportsProtocol(w, NET_WM_PING);
 
     client.topBar.closeIcon = XCreateSimpleWindow(
             display_,
@@ -296,30 +648,49 @@ void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
             20,
             0,
             0,
-            0x646375);
-    XSelectInput(display_, client.topBar.closeIcon, SubstructureRedirectMask | SubstructureNotifyMask);
-    XReparentWindow(display_, client.topBar.closeIcon, client.frame, x_window_attrs.width-23, 3);
-    XMapWindow(display_, client.topBar.closeIcon);
+            config_->title_color);
+    XSelectInput(display_, client.topBar.closeIcon, SubstructureRedirectMask | SubstructureNotifyMask | ExposureMask);
+    XReparentWindow(display_, client.topBar.closeIcon, client.frame, x_window_attrs.width-23, iconOffset());
+
+    client.topBar.maximizeIcon = XCreateSimpleWindow(
+            display_, client.frame, x_window_attrs.width-46, iconOffset(), 20, 20, 0, 0, config_->title_color);
+    XSelectInput(display_, client.topBar.maximizeIcon, ExposureMask);
+    client.topBar.minimizeIcon = XCreateSimpleWindow(
+            display_, client.frame, x_window_attrs.width-69, iconOffset(), 20, 20, 0, 0, config_->title_color);
+    XSelectInput(display_, client.topBar.minimizeIcon, ExposureMask);
+    if (!client.undecorated) {
+        for (Window decoration : {client.topBar.win, client.topBar.closeIcon,
+                                  client.topBar.maximizeIcon, client.topBar.minimizeIcon})
+            XMapWindow(display_, decoration);
+    }
 
     client.topBar.closeGC = XCreateGC(display_, client.topBar.closeIcon, 0, None);
-    drawCross(client);
+    drawIcons(client);
+    setWMState(w, NormalState);
 
-    clients_[client.topBar.win] = client.frame;
-    clients_[w] = client.frame;
-    clients_[client.topBar.closeIcon] = client.frame;
-    clientWindows.push_back(client);
+    for (Window window : clientWindows(client))
+        windows_.Insert(window, handle);
+    regroup(client);
 
-    XGrabButton(
-            display_,
-            Button1,
-            AnyModifier,
-            client.topBar.closeIcon,
-            false,
-            ButtonPressMask | ButtonReleaseMask,
-            GrabModeAsync,
-            GrabModeAsync,
-            None,
-            None);
+    grabClientInput(client);
+
+    LOG(INFO) << "Framed window " << w << " [" << client.frame << "]" << " [" << client.topBar.win << "]";
+}
+
+void WindowManager::grabClientInput(const ClientWin &client) {
+    for (Window icon : {client.topBar.closeIcon, client.topBar.maximizeIcon, client.topBar.minimizeIcon}) {
+        XGrabButton(
+                display_,
+                Button1,
+                AnyModifier,
+                icon,
+                false,
+                ButtonPressMask | ButtonReleaseMask,
+                GrabModeAsync,
+                GrabModeAsync,
+                None,
+                None);
+    }
     //   a. Move windows with left button.
     XGrabButton(
             display_,
@@ -327,65 +698,161 @@ void WindowManager::Frame(Window w, bool was_created_before_window_manager) {
             AnyModifier,
             client.topBar.win,
             false,
-            ButtonPressMask | ButtonMotionMask,
-            GrabModeAsync,
-            GrabModeAsync,
-            None,
-            None);
-    //   b. Resize windows with alt + right button.
-    XGrabButton(
-            display_,
-            Button1,
-            AnyModifier,
-            w,
-            false,
-            ButtonPressMask,
+            ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
             GrabModeAsync,
             GrabModeAsync,
             None,
             None);
+    //   b. Focus windows by clicking into them.
+    if (windows_.Find(client.w) != focused_)
+        grabClickToFocus(client.w);
     //   c. Kill windows with alt + f4.
+    grabKey(config_->close_key, client.frame);
+    //   d. Switch windows with alt + tab.
+    grabKey(config_->cycle_key, client.frame);
+    //   e. Show the overview.
+    grabKey(config_->overview_key, client.frame);
+}
+
+void WindowManager::grabKey(const KeyBinding &key, Window w) {
     XGrabKey(
             display_,
-            XKeysymToKeycode(display_, XK_F4),
-            Mod1Mask,
-            client.frame,
+            XKeysymToKeycode(display_, key.keysym),
+            key.modifiers,
+            w,
             false,
             GrabModeAsync,
             GrabModeAsync);
-    //   d. Switch windows with alt + tab.
-    XGrabKey(
+}
+
+void WindowManager::grabClickToFocus(Window w) {
+    // The pointer freezes on a click until OnButtonPress has set the focus
+    // and replays the click to the client.
+    XGrabButton(
             display_,
-            XKeysymToKeycode(display_, XK_Tab),
-            Mod1Mask,
+            AnyButton,
+            AnyModifier,
             w,
             false,
+            ButtonPressMask,
+            GrabModeSync,
             GrabModeAsync,
-            GrabModeAsync);
+            None,
+            None);
+}
 
-    LOG(INFO) << "Framed window " << w << " [" << client.frame << "]" << " [" << client.topBar.win << "]";
+long WindowManager::frameEventMask() const {
+    return SubstructureRedirectMask | SubstructureNotifyMask |
+           (config_->focus_follows_mouse ? EnterWindowMask : 0);
 }
 
 void WindowManager::Unframe(Window w) {
-    const Window frame = clients_[w];
-    XUnmapWindow(display_, frame);
-    XReparentWindow(
-            display_,
-            w,
-            root_,
-            0, 0);
-    XRemoveFromSaveSet(display_, w);
-    XDestroyWindow(display_, w);
-    clients_.erase(w);
+    const Handle handle = windows_.Find(w);
+    ClientWin *client = clients_.Get(handle);
+    CHECK_NOTNULL(client);
+    const Window frame = client->frame;
+    {
+        ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::UNFRAME, w);
+        recordRequest(X_UnmapWindow, frame);
+        XUnmapWindow(display_, frame);
+        recordRequest(X_ReparentWindow, w, root_);
+        XReparentWindow(
+                display_,
+                w,
+                root_,
+                0, 0);
+        XRemoveFromSaveSet(display_, w);
+        XDestroyWindow(display_, w);
+    }
+    releaseClient(handle);
     LOG(INFO) << "Unframed window " << w << " [" << frame << "]";
 }
 
+void WindowManager::releaseClient(Handle handle) {
+    ClientWin *client = clients_.Get(handle);
+    CHECK_NOTNULL(client);
+    const Window frame = client->frame;
+    const Window w = client->w;
+    ungroup(*client);
+    // Destroys the decorations along with the frame.
+    XFreeGC(display_, client->topBar.closeGC);
+    recordRequest(X_DestroyWindow, frame);
+    XDestroyWindow(display_, frame);
+    frames_.Remove(frame);
+    outputs_.RemoveStrut(client->w);
+    titles_->Forget(client->w);
+    timers_.Cancel(client->ping.timeout);
+    for (Window window : clientWindows(*client))
+        windows_.Erase(window);
+    clients_.Free(handle);
+    // Its transients fall back to their own group.
+    forEachClient([this, w](ClientWin &win) {
+        if (win.transientFor == w)
+            regroup(win);
+    });
+    if (overviewShown_)
+        showOverview();
+}
+
+void WindowManager::onRequestFailed(const ErrorTracker::Failure &f) {
+    const string request = errors_.RequestName(f.request_code, f.minor_code);
+    const Handle handle = windows_.Find(f.client);
+    const ClientWin *win = clients_.Get(handle);
+    // Clients can be destroyed at any time, which is not an error of ours.
+    const bool gone = f.resource == f.client && (f.error_code == BadWindow ||
+                                                 (f.operation == ErrorTracker::FOCUS &&
+                                                  f.error_code == BadMatch));
+    if (!gone) {
+        char error_text[1024];
+        XGetErrorText(display_, f.error_code, error_text, sizeof(error_text));
+        LOG(ERROR) << request << " failed with " << error_text << " while "
+                   << ErrorTracker::OperationName(f.operation) << " window " << f.client;
+        return;
+    }
+    LOG(INFO) << "Window " << f.client << " vanished while "
+              << ErrorTracker::OperationName(f.operation) << " it (" << request << ")";
+    // The frame went up around a window that no longer exists.
+    if (f.operation == ErrorTracker::FRAME && win != nullptr && win->w == f.client) {
+        LOG(INFO) << "Rolling back the frame of window " << f.client;
+        releaseClient(handle);
+    }
+}
+
 
 void WindowManager::OnCreateNotify(const XCreateWindowEvent &e) {}
 void WindowManager::OnReparentNotify(const XReparentEvent &e) {}
-void WindowManager::OnMapNotify(const XMapEvent &e) {}
-void WindowManager::OnDestroyNotify(const XDestroyWindowEvent &e) {}
-void WindowManager::OnConfigureNotify(const XConfigureEvent &e) {}
+void WindowManager::OnMapNotify(const XMapEvent &e) {
+    if (e.event == root_)
+        frames_.SetMapped(e.window, true);
+}
+void WindowManager::OnDestroyNotify(const XDestroyWindowEvent &e) {
+    if (e.event == root_) {
+        frames_.Remove(e.window);
+        return;
+    }
+    // Mapped clients are unframed on their UnmapNotify; minimized ones are
+    // destroyed without one.
+    const ClientWin *win = clientFor(e.window);
+    if (win != nullptr && win->w == e.window) {
+        LOG(INFO) << "Window " << e.window << " destroyed while minimized";
+        releaseClient(windows_.Find(e.window));
+    }
+}
+void WindowManager::OnConfigureNotify(const XConfigureEvent &e) {
+    Box previous;
+    if (e.event != root_ || !frames_.Get(e.window, &previous))
+        return;
+    const Box outer = Box{e.x, e.y, e.width, e.height}.Inflate(2 * e.border_width, 2 * e.border_width);
+    frames_.Update(e.window, outer);
+    frames_.Restack(e.window, e.above);
+    if (outer.width != previous.width || outer.height != previous.height)
+        shapes_.Apply(e.window, outer.width, outer.height, e.border_width, config_->frame_radius,
+                      config_->see_through_border);
+    const ClientWin *win = clientFor(e.window);
+    // The geometry before maximizing is what should be restored next time.
+    if (session_ && win != nullptr && win->sessionKey != 0 && !win->maximized)
+        session_->Remember(win->sessionKey, outer);
+}
 
 void WindowManager::OnConfigureRequest(const XConfigureRequestEvent &e) {
     XWindowChanges changes;
@@ -396,84 +863,1181 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent &e) {
     changes.border_width = e.border_width;
     changes.sibling = e.above;
     changes.stack_mode = e.detail;
-    if (clients_.count(e.window)) {
-        const Window frame =  clients_[e.window];
+    ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::CONFIGURE, e.window);
+    ClientWin *win = clientFor(e.window);
+    if (win != nullptr) {
+        const Window frame = win->frame;
+        recordRequest(X_ConfigureWindow, frame, e.value_mask);
         XConfigureWindow(display_, frame, e.value_mask, &changes);
         LOG(INFO) << "Resize [" << frame << "] to " << Size<int>(e.window, e.height);
+
+        if (e.value_mask & CWWidth)
+            layoutTitleBar(*win, e.width);
     }
 
+    recordRequest(X_ConfigureWindow, e.window, e.value_mask);
     XConfigureWindow(display_, e.window, e.value_mask, &changes);
     LOG(INFO) << "Resize " << e.window << "to " << Size<int>(e.width, e.height);
 }
 
 void WindowManager::OnMapRequest(const XMapRequestEvent &e) {
+    ClientWin *client = clientFor(e.window);
+    if (client != nullptr && client->w == e.window) {
+        // A minimized client leaves the iconic state by mapping itself.
+        LOG(INFO) << "Window " << e.window << " restores itself";
+        if (client->workspace == currentWorkspace_)
+            focusWindow(*client);
+        else
+            unminimize(*client);
+        return;
+    }
+    ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::FRAME, e.window);
     Frame(e.window, false);
+    recordRequest(X_MapWindow, e.window);
     XMapWindow(display_, e.window);
+    ClientWin *win = clientFor(e.window);
+    if (win != nullptr && win->workspace == currentWorkspace_)
+        setFocus(*win);
 }
 
 void WindowManager::OnUnmapNotify(const XUnmapEvent &e) {
-    if (!clients_.count(e.window)) {
+    if (e.event == root_ && frames_.Contains(e.window)) {
+        frames_.SetMapped(e.window, false);
+        return;
+    }
+
+    ClientWin *win = clientFor(e.window);
+    if (win == nullptr || win->w != e.window) {
         LOG(INFO) << "UnmapNotify ignored for non-client window " << e.window;
         return;
     }
 
     if (e.event == root_) {
+        // Minimized clients are already unmapped and withdraw with a
+        // synthetic UnmapNotify instead.
+        if (e.send_event && win->minimized) {
+            Unframe(e.window);
+            return;
+        }
         LOG(INFO) << "UnmapNotify ignored for reparented pre-existing Window " << e.window;
         return;
     }
 
+    if (win->ignoreUnmaps > 0) {
+        --win->ignoreUnmaps;
+        return;
+    }
+
     Unframe(e.window);
 }
 
 void WindowManager::OnButtonPress(const XButtonEvent &e) {
     LOG(INFO) << "Button press on " << e.window;
-    CHECK(clients_.count(e.window));
-    Window frame;
-    if (clients_.count(e.window))
-        frame = clients_[e.window];
+    if (overviewShown_) {
+        pickFromOverview(e.x_root, e.y_root);
+        return;
+    }
+    // Clicks can still arrive for windows unmanaged in the meantime.
+    ClientWin *win = clientFor(e.window);
+    if (win == nullptr) {
+        XAllowEvents(display_, ReplayPointer, e.time);
+        return;
+    }
+    const Window frame = win->frame;
+
+    if (win->topBar.win == e.window) {
+        LOG(INFO) << "Clicked on TopBar";
+    } else if (win->topBar.closeIcon == e.window) {
+        LOG(INFO) << "Clicked on CloseIcon -> Frame: " << frame;
+    }
+    lastPointer_ = Position<int>(e.x_root, e.y_root);
+    raiseGroup(*win);
+    setFocus(*win);
+    if (e.window == win->topBar.win && e.button == Button1)
+        beginDrag(*win, e);
+    // Hands a click-to-focus click on to the client.
+    if (e.window == win->w)
+        XAllowEvents(display_, ReplayPointer, e.time);
+}
+void WindowManager::OnButtonRelease(const XButtonEvent &e) {
+    if (clients_.Get(drag_.client) != nullptr && !drag_.xinput && e.button == Button1)
+        endDrag(e.time);
+    ClientWin *win = clientFor(e.window);
+    if (win == nullptr)
+        return;
+    if (win->topBar.closeIcon == e.window)
+        closeWindow(win->w);
+    else if (win->topBar.maximizeIcon == e.window)
+        toggleMaximize(*win);
+    else if (win->topBar.minimizeIcon == e.window)
+        minimize(*win);
+}
+void WindowManager::OnMotionNotify(const XMotionEvent &e) {
+    lastPointer_ = Position<int>(e.x_root, e.y_root);
+    if (clients_.Get(drag_.client) != nullptr && !drag_.xinput && (e.state & Button1Mask))
+        dragMotion(e.x_root, e.y_root, e.time);
+}
+void WindowManager::OnGenericEvent(XGenericEventCookie &cookie) {
+    if (cookie.extension != xiOpcode_ || !drag_.xinput || !XGetEventData(display_, &cookie))
+        return;
+    const XIDeviceEvent *e = static_cast<const XIDeviceEvent *>(cookie.data);
+    lastPointer_ = Position<int>(static_cast<int>(e->root_x), static_cast<int>(e->root_y));
+    if (cookie.evtype == XI_Motion) {
+        dragMotion(e->root_x, e->root_y, e->time);
+    } else if (cookie.evtype == XI_ButtonRelease && e->detail == Button1) {
+        dragMotion(e->root_x, e->root_y, e->time);
+        endDrag(e->time);
+    }
+    XFreeEventData(display_, &cookie);
+}
+void WindowManager::OnKeyPress(const XKeyEvent &e) {
+    auto pressed = [this, &e](const KeyBinding &key) {
+        return (e.state & key.modifiers) == key.modifiers &&
+               e.keycode == XKeysymToKeycode(display_, key.keysym);
+    };
+    if (overviewShown_) {
+        if (pressed(config_->overview_key) ||
+            e.keycode == XKeysymToKeycode(display_, XK_Escape))
+            hideOverview();
+    } else if (pressed(config_->close_key)) {
+        closeWindow(e.window);
+    } else if (pressed(config_->cycle_key)) {
+        cycleFocus();
+    } else if (pressed(config_->overview_key)) {
+        showOverview();
+    }
+}
+void WindowManager::OnKeyRelease(const XKeyEvent &e) {}
+
+void WindowManager::OnEnterNotify(const XCrossingEvent &e) {
+    if (!config_->focus_follows_mouse || e.mode != NotifyNormal || e.detail == NotifyInferior)
+        return;
+    const Handle handle = windows_.Find(e.window);
+    timers_.Cancel(focusTimer_);
+    focusTimer_ = 0;
+    if (clients_.Get(handle) == nullptr || handle == focused_)
+        return;
+    // Focus only follows once the pointer rests, so sweeping across many
+    // windows does not focus each of them in turn.
+    focusTimer_ = timers_.Schedule(config_->focus_delay_ms, [this, handle]() {
+        focusTimer_ = 0;
+        ClientWin *win = clients_.Get(handle);
+        if (win != nullptr)
+            setFocus(*win);
+    });
+}
+
+void WindowManager::OnScreenChange() {
+    const ::std::vector<Output> changed = outputs_.Refresh();
+    if (compositor_)
+        compositor_->Resize();
+    if (changed.empty())
+        return;
+
+    // Only frames whose centre was on a changed or removed output move. They
+    // keep their offset on an output that changed geometry and move to the
+    // nearest remaining output otherwise.
+    forEachClient([&](ClientWin &clientWin) {
+        Box outer;
+        if (!frames_.Get(clientWin.frame, &outer))
+            return;
+        const Position<int> center = outer.center();
+        for (const Output & old : changed) {
+            if (!old.area.Contains(center.x, center.y))
+                continue;
+            const Output *now = outputs_.Find(old.name);
+            const Box area = now != nullptr ? now->area : outputs_.At(center.x, center.y).area;
+            if (clientWin.maximized) {
+                setFrameGeometry(clientWin, area);
+                break;
+            }
+            const Box moved = outer.Translate(area.x - old.area.x, area.y - old.area.y).ClampInto(area);
+            if (moved != outer) {
+                XMoveWindow(display_, clientWin.frame, moved.x, moved.y);
+                LOG(INFO) << "Moved frame " << clientWin.frame << " to " << moved
+                          << " after output change";
+            }
+            break;
+        }
+    });
+}
+
+void WindowManager::OnPropertyNotify(const XPropertyEvent &e) {
+    ClientWin *win = clientFor(e.window);
+    if (win == nullptr || win->w != e.window)
+        return;
+    if (e.atom == WM_PROTOCOLS) {
+        win->ping.supported = supportsProtocol(e.window, NET_WM_PING);
+        return;
+    }
+    if (e.atom == XA_WM_TRANSIENT_FOR || e.atom == XA_WM_HINTS) {
+        fetchGroupHints(*win);
+        regroup(*win);
+        return;
+    }
+    if (outputs_.IsStrutProperty(e.atom)) {
+        outputs_.UpdateStrut(win->w);
+        return;
+    }
+    if (e.atom != XA_WM_NAME && e.atom != NET_WM_NAME)
+        return;
+    string title = TitleRenderer::FetchTitle(display_, win->w);
+    if (win->ping.hung)
+        title += " (not responding)";
+    if (titles_->SetTitle(win->w, title))
+        drawTitle(*win);
+}
+
+void WindowManager::OnExpose(const XExposeEvent &e) {
+    if (e.window != root_) {
+        if (e.count == 0) {
+            const ClientWin *win = clientFor(e.window);
+            if (win == nullptr)
+                return;
+            if (win->topBar.win == e.window)
+                drawTitle(*win);
+            else if (win->w != e.window && win->frame != e.window)
+                drawIcons(*win);
+        }
+        return;
+    }
+    XClearWindow(display_, root_);
+    XSetWindowBackgroundPixmap(display_, root_, bg.pixmap);
+    forEachClient([this](ClientWin &clientWin) {
+        drawIcons(clientWin);
+    });
+}
+
+void WindowManager::OnClientMessage(const XClientMessageEvent &e) {
+    if (e.message_type == WM_CHANGE_STATE && e.data.l[0] == IconicState) {
+        ClientWin *win = clientFor(e.window);
+        if (win != nullptr && win->w == e.window)
+            minimize(*win);
+        return;
+    }
+    // Pongs are ping messages sent back to the root window.
+    if (e.window != root_ || e.message_type != WM_PROTOCOLS ||
+        static_cast<Atom>(e.data.l[0]) != NET_WM_PING)
+        return;
+    ClientWin *win = clientFor(e.data.l[2]);
+    if (win == nullptr || win->ping.timeout == 0 || win->ping.serial != e.data.l[1])
+        return;
+    timers_.Cancel(win->ping.timeout);
+    win->ping.timeout = 0;
+    // The client is alive and decides itself whether to close.
+    win->ping.closing = false;
+    if (win->ping.hung)
+        setResponding(*win, true);
+}
+
+void WindowManager::sendPing(Handle client) {
+    ClientWin *win = clients_.Get(client);
+    if (win == nullptr)
+        return;
+    PingState &ping = win->ping;
+    if (ping.timeout != 0)
+        return;
+    const Window w = win->w;
+    ping.serial = ++pingSerial_;
+
+    XEvent msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.xclient.type = ClientMessage;
+    msg.xclient.message_type = WM_PROTOCOLS;
+    msg.xclient.window = w;
+    msg.xclient.format = 32;
+    msg.xclient.data.l[0] = NET_WM_PING;
+    // Echoed back by the client; a serial identifies stale pongs.
+    msg.xclient.data.l[1] = ping.serial;
+    msg.xclient.data.l[2] = w;
+    recordRequest(X_SendEvent, w, NET_WM_PING);
+    XSendEvent(display_, w, false, NoEventMask, &msg);
+    // The handle goes stale if the client is unframed in the meantime.
+    ping.timeout = timers_.Schedule(config_->ping_timeout_ms, [this, client]() {
+        onPingTimeout(client);
+    });
+}
+
+void WindowManager::pingAll() {
+    pingTimer_ = 0;
+    clients_.ForEach([this](Handle client, ClientWin &win) {
+        if (win.ping.supported)
+            sendPing(client);
+    });
+    if (config_->ping_interval_ms > 0)
+        pingTimer_ = timers_.Schedule(config_->ping_interval_ms, [this]() { pingAll(); });
+}
+
+void WindowManager::onPingTimeout(Handle client) {
+    ClientWin *win = clients_.Get(client);
+    if (win == nullptr)
+        return;
+    win->ping.timeout = 0;
+    if (win->ping.closing) {
+        LOG(WARNING) << "Killing unresponsive client of window " << win->w;
+        recordRequest(X_KillClient, win->w);
+        XKillClient(display_, win->w);
+        return;
+    }
+    if (!win->ping.hung) {
+        LOG(WARNING) << "Window " << win->w << " is not responding";
+        setResponding(*win, false);
+    }
+}
+
+void WindowManager::setResponding(ClientWin &win, bool responding) {
+    win.ping.hung = !responding;
+    XSetWindowBorder(display_, win.frame, responding ? config_->border_color : config_->hung_border_color);
+    string title = TitleRenderer::FetchTitle(display_, win.w);
+    if (!responding)
+        title += " (not responding)";
+    if (titles_->SetTitle(win.w, title))
+        drawTitle(win);
+}
+
+void WindowManager::schedulePaint() {
+    if (!compositor_ || paintTimer_ != 0 || !compositor_->NeedsPaint())
+        return;
+    const uint64_t now = TimerWheel::Now();
+    const uint64_t due = lastPaint_ + config_->paint_interval_ms;
+    auto paint = [this]() {
+        paintTimer_ = 0;
+        lastPaint_ = TimerWheel::Now();
+        compositor_->Paint();
+    };
+    if (due <= now)
+        paint();
     else
-        frame = e.window;
+        paintTimer_ = timers_.Schedule(due - now, paint);
+}
+
+void WindowManager::setWMState(Window w, long state) {
+    const long data[2] = {state, static_cast<long>(None)};
+    XChangeProperty(display_, w, WM_STATE, WM_STATE, 32, PropModeReplace,
+                    reinterpret_cast<const unsigned char *>(data), 2);
+}
+
+void WindowManager::layoutTitleBar(ClientWin &win, unsigned int width) {
+    if (win.topBar.width == width)
+        return;
+    win.topBar.width = width;
+    XResizeWindow(display_, win.topBar.win, width, config_->title_height);
+    XMoveWindow(display_, win.topBar.closeIcon, width - 23, iconOffset());
+    XMoveWindow(display_, win.topBar.maximizeIcon, width - 46, iconOffset());
+    XMoveWindow(display_, win.topBar.minimizeIcon, width - 69, iconOffset());
+    drawTitle(win);
+}
 
-    for(auto & clientWindow : clientWindows) {
-        if (isTopBar(clientWindows, e.window)) {
-            LOG(INFO) << "Clicked on TopBar";
-        } else if (isCloseIcon(clientWindows, e.window)) {
-            LOG(INFO) << "Clicked on CloseIcon -> Frame: " << frame;
+void WindowManager::setFrameGeometry(ClientWin &win, const Box &outer) {
+    ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::CONFIGURE, win.w);
+    const int width = outer.width - 2 * BORDERWIDTH;
+    const int height = outer.height - 2 * BORDERWIDTH;
+    recordRequest(X_ConfigureWindow, win.frame, CWX | CWY | CWWidth | CWHeight);
+    XMoveResizeWindow(display_, win.frame, outer.x, outer.y, width, height);
+    XResizeWindow(display_, win.w, width, height - titleHeight(win));
+    layoutTitleBar(win, width);
+}
+
+void WindowManager::toggleMaximize(ClientWin &win) {
+    if (win.maximized) {
+        win.maximized = false;
+        setFrameGeometry(win, win.restore);
+    } else {
+        Box outer;
+        if (!frames_.Get(win.frame, &outer))
+            return;
+        win.restore = outer;
+        win.maximized = true;
+        const Position<int> center = outer.center();
+        setFrameGeometry(win, outputs_.WorkArea(center.x, center.y));
+    }
+    drawIcons(win);
+}
+
+void WindowManager::minimize(ClientWin &win) {
+    forEachInGroup(win, [this](Handle, ClientWin &member) {
+        setMinimized(member, true);
+    });
+}
+
+void WindowManager::unminimize(ClientWin &win) {
+    forEachInGroup(win, [this](Handle, ClientWin &member) {
+        setMinimized(member, false);
+    });
+}
+
+void WindowManager::setMinimized(ClientWin &win, bool minimized) {
+    if (win.minimized == minimized)
+        return;
+    win.minimized = minimized;
+    setWMState(win.w, minimized ? IconicState : NormalState);
+    // The client is unmapped too, so that it can leave the iconic state by
+    // mapping itself, which reaches OnMapRequest. OnUnmapNotify does not take
+    // its UnmapNotify for a withdrawal.
+    if (minimized) {
+        ++win.ignoreUnmaps;
+        recordRequest(X_UnmapWindow, win.w);
+        XUnmapWindow(display_, win.w);
+        recordRequest(X_UnmapWindow, win.frame);
+        XUnmapWindow(display_, win.frame);
+        return;
+    }
+    recordRequest(X_MapWindow, win.w);
+    XMapWindow(display_, win.w);
+    if (win.workspace == currentWorkspace_) {
+        recordRequest(X_MapWindow, win.frame);
+        XMapWindow(display_, win.frame);
+    }
+}
+
+::std::shared_ptr<const Config> WindowManager::readConfig() const {
+    Config config = baseConfig_;
+    if (ReadConfigFile(ConfigPath(), &config))
+        LOG(INFO) << "Read settings from " << ConfigPath();
+    return ::std::make_shared<const Config>(config);
+}
+
+void WindowManager::reloadConfig() {
+    const ::std::shared_ptr<const Config> previous = config_;
+    config_ = readConfig();
+    const Config &was = *previous;
+    const Config &now = *config_;
+
+    if (now.compositing != was.compositing || now.restore_session != was.restore_session)
+        LOG(WARNING) << "compositing and restore_session take effect after a restart";
+    if (now.wallpaper != was.wallpaper) {
+        if (bg.pixmap != None)
+            XFreePixmap(display_, bg.pixmap);
+        bg.pixmap = None;
+        setBackground(now.wallpaper.c_str());
+        XSetWindowBackgroundPixmap(display_, root_, bg.pixmap);
+        XClearWindow(display_, root_);
+        if (compositor_)
+            compositor_->SetWallpaper(bg.pixmap);
+    }
+    if (now.title_color != was.title_color)
+        titles_->SetColors(0xFFFFFF, now.title_color);
+    if (now.ping_interval_ms != was.ping_interval_ms) {
+        timers_.Cancel(pingTimer_);
+        pingTimer_ = 0;
+        if (now.ping_interval_ms > 0)
+            pingTimer_ = timers_.Schedule(now.ping_interval_ms, [this]() { pingAll(); });
+    }
+    if (!now.focus_follows_mouse) {
+        timers_.Cancel(focusTimer_);
+        focusTimer_ = 0;
+    }
+
+    // Only what changed is sent to the server. Everything else, like the
+    // snap threshold or timeouts, is read from config_ when it is used.
+    const bool colors = now.border_color != was.border_color ||
+                        now.hung_border_color != was.hung_border_color ||
+                        now.frame_color != was.frame_color;
+    const bool titles = now.title_color != was.title_color;
+    const bool layout = now.title_height != was.title_height;
+    const bool shape = now.frame_radius != was.frame_radius ||
+                       now.see_through_border != was.see_through_border;
+    const bool decorate = compositor_ && (now.frame_opacity != was.frame_opacity ||
+                                          now.shadows != was.shadows);
+    const bool crossing = now.focus_follows_mouse != was.focus_follows_mouse;
+    const bool keys = now.close_key != was.close_key || now.cycle_key != was.cycle_key ||
+                      now.overview_key != was.overview_key;
+    if (!(colors || titles || layout || shape || decorate || crossing || keys)) {
+        LOG(INFO) << "Reloaded settings";
+        return;
+    }
+    forEachClient([&](ClientWin &win) {
+        if (colors) {
+            XSetWindowBorder(display_, win.frame,
+                             win.ping.hung ? now.hung_border_color : now.border_color);
+            XSetWindowBackground(display_, win.frame, now.frame_color);
+        }
+        if (titles) {
+            XSetWindowBackground(display_, win.topBar.win, now.title_color);
+            XClearWindow(display_, win.topBar.win);
+            drawTitle(win);
+            drawIcons(win);
+        }
+        Box outer;
+        if (layout && frames_.Get(win.frame, &outer)) {
+            // Lays the title bar out again even though its width is the same.
+            win.topBar.width = 0;
+            XMoveWindow(display_, win.w, 0, titleHeight(win));
+            setFrameGeometry(win, outer);
+        }
+        if (shape && frames_.Get(win.frame, &outer))
+            shapes_.Apply(win.frame, outer.width, outer.height, BORDERWIDTH, now.frame_radius,
+                          now.see_through_border);
+        if (decorate)
+            compositor_->Decorate(win.frame, now.frame_opacity, now.shadows);
+        if (crossing)
+            XSelectInput(display_, win.frame, frameEventMask());
+        if (keys) {
+            for (const KeyBinding *key : {&was.close_key, &was.cycle_key, &was.overview_key}) {
+                XUngrabKey(display_, XKeysymToKeycode(display_, key->keysym), key->modifiers,
+                           win.frame);
+            }
+            grabKey(now.close_key, win.frame);
+            grabKey(now.cycle_key, win.frame);
+            grabKey(now.overview_key, win.frame);
+        }
+    });
+    LOG(INFO) << "Reloaded settings and updated " << clients_.size() << " clients";
+}
+
+void WindowManager::saveState() {
+    ::std::vector<long> state;
+    state.push_back(STATE_VERSION);
+    state.push_back(currentWorkspace_);
+    Window returned_root, returned_parent;
+    Window *children;
+    unsigned int num_children;
+    if (XQueryTree(display_, root_, &returned_root, &returned_parent, &children, &num_children)) {
+        for (unsigned int i = 0; i < num_children; ++i) {
+            const ClientWin *win = clientFor(children[i]);
+            Box outer;
+            if (win == nullptr || win->frame != children[i] || !frames_.Get(win->frame, &outer))
+                continue;
+            const long fields[STATE_FIELDS] = {
+                    static_cast<long>(win->w),
+                    static_cast<long>(win->frame),
+                    static_cast<long>(win->topBar.win),
+                    static_cast<long>(win->topBar.closeIcon),
+                    win->workspace,
+                    outer.x,
+                    outer.y,
+                    outer.width,
+                    outer.height,
+                    win->topBar.width,
+                    static_cast<long>(win->topBar.maximizeIcon),
+                    static_cast<long>(win->topBar.minimizeIcon),
+                    (win->maximized ? 1 : 0) | (win->minimized ? 2 : 0) |
+                            (win->undecorated ? 4 : 0),
+                    win->restore.x,
+                    win->restore.y,
+                    win->restore.width,
+                    win->restore.height,
+            };
+            state.insert(state.end(), fields, fields + STATE_FIELDS);
+            // Otherwise closing the connection reparents clients to the root.
+            XRemoveFromSaveSet(display_, win->w);
         }
+        XFree(children);
     }
-    startPos = Position<int>(e.x_root, e.y_root);
+    XChangeProperty(display_, root_, SIMPLEWM_STATE, XA_CARDINAL, 32, PropModeReplace,
+                    reinterpret_cast<const unsigned char *>(state.data()), state.size());
+    // Frames and decorations outlive the connection, for the next instance
+    // to adopt. The destructor frees the other resources first.
+    XSetCloseDownMode(display_, RetainPermanent);
+    XSync(display_, false);
+    LOG(INFO) << "Saved " << (state.size() - 2) / STATE_FIELDS << " clients for restart";
+}
+
+void WindowManager::adoptState() {
+    Atom type;
+    int format;
+    unsigned long n, bytes_after;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(display_, root_, SIMPLEWM_STATE, 0, 1 << 20, true, XA_CARDINAL,
+                           &type, &format, &n, &bytes_after, &data) != Success ||
+        data == nullptr)
+        return;
+    const long *state = reinterpret_cast<const long *>(data);
+    if (format != 32 || n < 2 || state[0] != STATE_VERSION || (n - 2) % STATE_FIELDS != 0) {
+        LOG(WARNING) << "Ignoring malformed restart state";
+        XFree(data);
+        return;
+    }
+
+    currentWorkspace_ = state[1];
+    for (unsigned long i = 2; i < n; i += STATE_FIELDS) {
+        const long *fields = state + i;
+        ClientWin client = ClientWin();
+        client.w = fields[0];
+        client.frame = fields[1];
+        client.topBar.win = fields[2];
+        client.topBar.closeIcon = fields[3];
+        client.workspace = fields[4];
+        client.topBar.width = fields[9];
+        client.topBar.maximizeIcon = fields[10];
+        client.topBar.minimizeIcon = fields[11];
+        client.maximized = fields[12] & 1;
+        client.minimized = fields[12] & 2;
+        client.undecorated = fields[12] & 4;
+        client.restore.x = static_cast<int32_t>(fields[13]);
+        client.restore.y = static_cast<int32_t>(fields[14]);
+        client.restore.width = fields[15];
+        client.restore.height = fields[16];
+        const Box outer{static_cast<int32_t>(fields[5]), static_cast<int32_t>(fields[6]),
+                        static_cast<int>(fields[7]), static_cast<int>(fields[8])};
+
+        // The client may have gone away while no window manager was running.
+        Window returned_root, parent;
+        Window *children;
+        unsigned int num_children;
+        if (!XQueryTree(display_, client.w, &returned_root, &parent, &children, &num_children)) {
+            XDestroyWindow(display_, client.frame);
+            continue;
+        }
+        XFree(children);
+        if (parent != client.frame) {
+            XDestroyWindow(display_, client.frame);
+            continue;
+        }
+
+        const Handle handle = clients_.Allocate();
+        ClientWin &win = *clients_.Get(handle);
+        win = client;
+        win.topBar.closeGC = XCreateGC(display_, win.topBar.closeIcon, 0, None);
+        // Clients are listed bottom to top, so this restores the stacking.
+        frames_.Update(win.frame, outer);
+        frames_.SetMapped(win.frame, win.workspace == currentWorkspace_ && !win.minimized);
+        if (compositor_)
+            compositor_->Decorate(win.frame, config_->frame_opacity, config_->shadows);
 
-    Window returned_root;
-    int x, y;
-    unsigned width, height, borderWidth, depth;
-    CHECK(XGetGeometry(display_, frame, &returned_root, &x, &y, &width, &height, &borderWidth, &depth));
-    startFramePos = Position<int>(x, y);
-    startFrameSize = Position<int>(width, height);
-    XRaiseWindow(display_, frame);
+        XSelectInput(display_, win.frame, frameEventMask());
+        XSelectInput(display_, win.topBar.win, SubstructureRedirectMask | SubstructureNotifyMask | ExposureMask);
+        XSelectInput(display_, win.topBar.closeIcon, SubstructureRedirectMask | SubstructureNotifyMask | ExposureMask);
+        XSelectInput(display_, win.topBar.maximizeIcon, ExposureMask);
+        XSelectInput(display_, win.topBar.minimizeIcon, ExposureMask);
+        XSelectInput(display_, win.w, PropertyChangeMask);
+        outputs_.UpdateStrut(win.w);
+        XAddToSaveSet(display_, win.w);
+        titles_->SetTitle(win.w, TitleRenderer::FetchTitle(display_, win.w));
+        win.ping.supported = supportsProtocol(win.w, NET_WM_PING);
+        string instance, wm_class;
+        fetchClass(win.w, &instance, &wm_class);
+        fetchGroupHints(win);
+        win.sessionKey = win.transientFor == None ? sessionKey(win.w, instance, wm_class) : 0;
+
+        for (Window window : clientWindows(win))
+            windows_.Insert(window, handle);
+        grabClientInput(win);
+        LOG(INFO) << "Adopted window " << win.w << " [" << win.frame << "]";
+    }
+    XFree(data);
+    // Parents may be listed after their transients.
+    forEachClient([this](ClientWin &win) {
+        regroup(win);
+    });
 }
-void WindowManager::OnButtonRelease(const XButtonEvent &e) {
-    if (isCloseIcon(clientWindows, e.window))
-        closeWindow(clients_[e.window]);
+
+Window WindowManager::releaseStaleFrame(Window w) {
+    Atom type;
+    int format;
+    unsigned long n, bytes_after;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(display_, w, SIMPLEWM_FRAME, 0, 1, false, XA_WINDOW,
+                           &type, &format, &n, &bytes_after, &data) != Success ||
+        data == nullptr)
+        return None;
+    const Window client = n == 1 && format == 32 ? *reinterpret_cast<long *>(data) : None;
+    XFree(data);
+    if (client == None)
+        return None;
+
+    XWindowAttributes attrs, inner;
+    if (!XGetWindowAttributes(display_, w, &attrs) || !XGetWindowAttributes(display_, client, &inner))
+        return None;
+    LOG(INFO) << "Releasing window " << client << " from stale frame " << w;
+    XReparentWindow(display_, client, root_, attrs.x, attrs.y + inner.y);
+    XMapWindow(display_, client);
+    XDestroyWindow(display_, w);
+    return client;
 }
-void WindowManager::OnMotionNotify(const XMotionEvent &e) {
-    CHECK(clients_.count(e.window));
-    if (!isTopBar(clientWindows, e.window))
+
+int WindowManager::titleHeight(const ClientWin &win) const {
+    return win.undecorated ? 0 : config_->title_height;
+}
+
+int WindowManager::iconOffset() const {
+    return (config_->title_height - 20) / 2;
+}
+
+void WindowManager::recordRequest(uint8_t opcode, Window w, unsigned long arg) {
+    FlightRecorder::Record(FlightRecord::REQUEST, opcode, 0, NextRequest(display_), w, arg);
+}
+
+ClientWin *WindowManager::clientFor(Window w) {
+    return clients_.Get(windows_.Find(w));
+}
+
+void WindowManager::beginDrag(ClientWin &win, const XButtonEvent &e) {
+    drag_ = Drag();
+    drag_.client = windows_.Find(win.w);
+    drag_.start_x = drag_.x = e.x_root;
+    drag_.start_y = drag_.y = e.y_root;
+    groupFrames(win, &drag_.frames);
+    if (drag_.frames.empty()) {
+        // The frame is already gone, e.g. while the client is withdrawn.
+        drag_ = Drag();
         return;
-    Window frame;
-    frame = clients_[e.window];
-    ClientWin win = getWin(clientWindows, frame);
+    }
+    drag_.start_frame = drag_.frames[0].second;
+    for (const auto &frame : drag_.frames)
+        drag_.moved.push_back(clients_.Get(frame.first)->frame);
+    drag_.clock_offset = INT64_MAX;
+    // An XInput 2 grab of the pointer replaces the core grab of the press,
+    // which then stops sending core motion events.
+    if (!config_->xinput_drag || xiOpcode_ < 0 ||
+        !XIGetClientPointer(display_, None, &drag_.pointer))
+        return;
+    unsigned char bits[XIMaskLen(XI_LASTEVENT)] = {};
+    XISetMask(bits, XI_Motion);
+    XISetMask(bits, XI_ButtonRelease);
+    XIEventMask mask{drag_.pointer, sizeof(bits), bits};
+    drag_.xinput = XIGrabDevice(display_, drag_.pointer, win.topBar.win, e.time, None,
+                                XIGrabModeAsync, XIGrabModeAsync, false, &mask) == Success;
+    if (!drag_.xinput)
+        LOG(WARNING) << "Failed to grab pointer " << drag_.pointer << ", dragging with core events";
+}
 
-    const Position<int> currentPos(e.x_root, e.y_root);
-    const Vector2D<int> delta = currentPos - startPos;
+void WindowManager::dragMotion(double x, double y, Time time) {
+    const int64_t offset = static_cast<int64_t>(TimerWheel::Now()) - time;
+    drag_.clock_offset = ::std::min(drag_.clock_offset, offset);
+    if (!drag_.pending)
+        drag_.time = time;
+    drag_.pending = true;
+    drag_.x = x;
+    drag_.y = y;
+    ++drag_.samples;
+}
+
+void WindowManager::applyDrag() {
+    const ClientWin *win = clients_.Get(drag_.client);
+    if (win == nullptr || !drag_.pending)
+        return;
+    drag_.pending = false;
+    const Box moving = drag_.start_frame.Translate(
+            static_cast<int>(::std::lround(drag_.x - drag_.start_x)),
+            static_cast<int>(::std::lround(drag_.y - drag_.start_y)));
+    const Position<int> snapped = SnapFrame(
+            frames_, drag_.moved,
+            outputs_.WorkArea(static_cast<int>(drag_.x), static_cast<int>(drag_.y)),
+            moving, config_->snap_threshold);
+    moveFrames(drag_.frames, snapped.x - drag_.start_frame.x, snapped.y - drag_.start_frame.y);
 
-    if (e.state & Button1Mask) {
-        const Position<int> destPos = startFramePos + delta;
-        XMoveWindow(display_, frame, destPos.x, destPos.y);
+    const int64_t latency = static_cast<int64_t>(TimerWheel::Now()) -
+                            (static_cast<int64_t>(drag_.time) + drag_.clock_offset);
+    ++drag_.moves;
+    drag_.latency_total += latency;
+    drag_.latency_max = max<uint64_t>(drag_.latency_max, latency);
+}
+
+void WindowManager::endDrag(Time time) {
+    applyDrag();
+    if (drag_.xinput)
+        XIUngrabDevice(display_, drag_.pointer, time);
+    if (drag_.moves > 0) {
+        LOG(INFO) << "Drag through " << (drag_.xinput ? "XInput 2" : "core events") << ": "
+                  << drag_.samples << " samples, " << drag_.moves << " moves, latency "
+                  << drag_.latency_total / drag_.moves << " ms mean, "
+                  << drag_.latency_max << " ms max";
     }
+    drag_ = Drag();
 }
-void WindowManager::OnKeyPress(const XKeyEvent &e) {
-    if ((e.state & Mod1Mask) && e.keycode == XKeysymToKeycode(display_, XK_F4)) {
-        closeWindow(e.window);
+
+void WindowManager::showOverview() {
+    if (!compositor_) {
+        LOG(WARNING) << "The overview needs compositing";
+        return;
+    }
+    ::std::vector<::std::pair<Handle, Box>> clients;
+    forEachClient([&](ClientWin &win) {
+        Box outer;
+        if (win.workspace == currentWorkspace_ && !win.minimized && frames_.Get(win.frame, &outer))
+            clients.emplace_back(windows_.Find(win.w), outer);
+    });
+    // In reading order, so that the grid resembles the screen.
+    ::std::sort(clients.begin(), clients.end(), [](const ::std::pair<Handle, Box> &a,
+                                                   const ::std::pair<Handle, Box> &b) {
+        return a.second.y != b.second.y ? a.second.y < b.second.y : a.second.x < b.second.x;
+    });
+    ::std::vector<Box> frames;
+    for (const auto &client : clients)
+        frames.push_back(client.second);
+    const ::std::vector<Box> thumbnails =
+            GridLayout(outputs_.WorkArea(lastPointer_.x, lastPointer_.y), frames, OVERVIEW_GAP);
+
+    overview_.clear();
+    ::std::vector<::std::pair<Window, Box>> shown;
+    for (size_t i = 0; i < clients.size(); ++i) {
+        overview_.emplace_back(clients[i].first, thumbnails[i]);
+        shown.emplace_back(clients_.Get(clients[i].first)->frame, thumbnails[i]);
+    }
+    compositor_->ShowOverview(shown);
+    if (overviewShown_)
+        return;
+    // Without both grabs no thumbnail could be picked and the overview could
+    // not be dismissed, e.g. while another client holds a grab.
+    const bool pointer = XGrabPointer(display_, root_, false, ButtonPressMask, GrabModeAsync,
+                                      GrabModeAsync, None, None, CurrentTime) == GrabSuccess;
+    const bool keyboard = pointer && XGrabKeyboard(display_, root_, false, GrabModeAsync,
+                                                   GrabModeAsync, CurrentTime) == GrabSuccess;
+    if (!keyboard) {
+        LOG(WARNING) << "Not showing the overview, failed to grab the "
+                     << (pointer ? "keyboard" : "pointer");
+        if (pointer)
+            XUngrabPointer(display_, CurrentTime);
+        compositor_->HideOverview();
+        overview_.clear();
+        return;
+    }
+    overviewShown_ = true;
+}
+
+void WindowManager::hideOverview() {
+    if (!overviewShown_)
+        return;
+    XUngrabPointer(display_, CurrentTime);
+    XUngrabKeyboard(display_, CurrentTime);
+    compositor_->HideOverview();
+    overview_.clear();
+    overviewShown_ = false;
+}
+
+void WindowManager::pickFromOverview(int x, int y) {
+    Handle picked;
+    for (const auto &thumbnail : overview_) {
+        if (thumbnail.second.Contains(x, y))
+            picked = thumbnail.first;
+    }
+    hideOverview();
+    ClientWin *win = clients_.Get(picked);
+    if (win != nullptr)
+        focusWindow(*win);
+}
+
+void WindowManager::fetchGroupHints(ClientWin &win) {
+    if (!XGetTransientForHint(display_, win.w, &win.transientFor))
+        win.transientFor = None;
+    win.leader = None;
+    XWMHints *hints = XGetWMHints(display_, win.w);
+    if (hints != nullptr) {
+        if (hints->flags & WindowGroupHint)
+            win.leader = hints->window_group;
+        XFree(hints);
+    }
+}
+
+Window WindowManager::groupKey(const ClientWin &win) {
+    const ClientWin *member = &win;
+    for (int depth = 0; depth < MAX_TRANSIENT_DEPTH; ++depth) {
+        if (member->leader != None)
+            return member->leader;
+        // Transients for the root window or for windows not managed, as
+        // some toolkits set for dialogs of the whole group, stay alone.
+        const ClientWin *parent = clientFor(member->transientFor);
+        if (parent == nullptr || parent->w != member->transientFor)
+            return member->w;
+        member = parent;
+    }
+    return win.w;
+}
+
+void WindowManager::regroup(ClientWin &win, int depth) {
+    const Window key = groupKey(win);
+    if (key != win.group) {
+        ungroup(win);
+        const Handle *head = groups_.Find(key);
+        win.group = key;
+        win.groupNext = head != nullptr ? *head : Handle();
+        groups_.Insert(key, windows_.Find(win.w));
+    }
+    if (depth >= MAX_TRANSIENT_DEPTH)
+        return;
+    forEachClient([this, &win, depth](ClientWin &transient) {
+        if (transient.transientFor == win.w && &transient != &win)
+            regroup(transient, depth + 1);
+    });
+}
+
+void WindowManager::ungroup(ClientWin &win) {
+    Handle *link = groups_.Find(win.group);
+    if (link == nullptr)
+        return;
+    const Handle handle = windows_.Find(win.w);
+    while (*link && *link != handle)
+        link = &clients_.Get(*link)->groupNext;
+    if (*link)
+        *link = win.groupNext;
+    win.groupNext = Handle();
+    const Handle *head = groups_.Find(win.group);
+    if (!*head)
+        groups_.Erase(win.group);
+}
+
+bool WindowManager::isTransientOf(const ClientWin &win, Window ancestor) {
+    const ClientWin *member = &win;
+    for (int depth = 0; depth < MAX_TRANSIENT_DEPTH && member != nullptr; ++depth) {
+        if (member->transientFor == ancestor)
+            return true;
+        member = clientFor(member->transientFor);
+    }
+    return false;
+}
+
+void WindowManager::groupFrames(const ClientWin &win, ::std::vector<::std::pair<Handle, Box>> *out) {
+    Box outer;
+    if (!frames_.Get(win.frame, &outer))
+        return;
+    out->emplace_back(windows_.Find(win.w), outer);
+    forEachInGroup(win, [&](Handle handle, ClientWin &member) {
+        if (&member == &win || member.workspace != win.workspace || member.minimized ||
+            member.maximized || !frames_.Get(member.frame, &outer))
+            return;
+        out->emplace_back(handle, outer);
+    });
+}
+
+void WindowManager::moveFrames(const ::std::vector<::std::pair<Handle, Box>> &frames,
+                               int dx, int dy) {
+    // All moves go out in the same flush, so the group is shown moved in
+    // one go.
+    for (const auto &frame : frames) {
+        const ClientWin *member = clients_.Get(frame.first);
+        if (member == nullptr)
+            continue;
+        ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::CONFIGURE, member->w);
+        recordRequest(X_ConfigureWindow, member->frame, CWX | CWY);
+        XMoveWindow(display_, member->frame, frame.second.x + dx, frame.second.y + dy);
+    }
+}
+
+void WindowManager::raiseGroup(const ClientWin &win) {
+    ::std::vector<Window> frames;
+    forEachInGroup(win, [&frames](Handle, ClientWin &member) {
+        frames.push_back(member.frame);
+    });
+    if (frames.empty()) {
+        // Not linked into its group (yet); raise the client on its own.
+        frames.push_back(win.frame);
+    }
+    // Skip frames that are gone or no longer lead to their client.
+    frames.erase(::std::remove_if(frames.begin(), frames.end(),
+                                  [this](Window frame) { return clientFor(frame) == nullptr; }),
+                 frames.end());
+    if (frames.empty())
+        return;
+    frames_.SortByStacking(&frames);
+    // Layers from the bottom: the main windows of the group, the client if
+    // it is one, the dialogs of the group, the client if it is a dialog,
+    // and the dialogs of the client. Within a layer the stacking is kept.
+    auto layer = [this, &win](Window frame) {
+        const ClientWin &member = *clientFor(frame);
+        if (&member == &win)
+            return win.transientFor == None ? 1 : 3;
+        if (isTransientOf(member, win.w))
+            return 4;
+        return member.transientFor == None ? 0 : 2;
+    };
+    ::std::stable_sort(frames.begin(), frames.end(), [&layer](Window a, Window b) {
+        return layer(a) < layer(b);
+    });
+    for (Window frame : frames)
+        frames_.Raise(frame);
+
+    // One raise of the top frame, then every other frame restacked right
+    // below the one above it.
+    ::std::reverse(frames.begin(), frames.end());
+    recordRequest(X_ConfigureWindow, frames.front(), CWStackMode);
+    XRaiseWindow(display_, frames.front());
+    if (frames.size() > 1)
+        XRestackWindows(display_, frames.data(), frames.size());
+}
+
+void WindowManager::focusWindow(ClientWin &win) {
+    unminimize(win);
+    raiseGroup(win);
+    setFocus(win);
+}
+
+void WindowManager::setFocus(ClientWin &win) {
+    ErrorTracker::Scope scope(&errors_, display_, ErrorTracker::FOCUS, win.w);
+    const Handle handle = windows_.Find(win.w);
+    if (handle != focused_) {
+        // Clicks into the previously focused client focus it again; clicks
+        // into the focused one go straight to it.
+        ClientWin *previous = clients_.Get(focused_);
+        if (previous != nullptr)
+            grabClickToFocus(previous->w);
+        XUngrabButton(display_, AnyButton, AnyModifier, win.w);
+        focused_ = handle;
+    }
+    recordRequest(X_SetInputFocus, win.w);
+    XSetInputFocus(display_, win.w, RevertToPointerRoot, CurrentTime);
+}
+
+void WindowManager::cycleFocus() {
+    // The next client after the focused one in pool order, wrapping around.
+    Handle first, next;
+    bool passed = false;
+    clients_.ForEach([&](Handle handle, ClientWin &win) {
+        if (win.workspace != currentWorkspace_ || win.minimized)
+            return;
+        if (!first)
+            first = handle;
+        if (passed && !next)
+            next = handle;
+        passed = passed || handle == focused_;
+    });
+    ClientWin *win = clients_.Get(next ? next : first);
+    if (win != nullptr)
+        focusWindow(*win);
+}
+
+void WindowManager::switchWorkspace(int workspace) {
+    if (workspace == currentWorkspace_)
+        return;
+    currentWorkspace_ = workspace;
+    forEachClient([this, workspace](ClientWin &clientWin) {
+        if (clientWin.minimized)
+            return;
+        if (clientWin.workspace == workspace) {
+            recordRequest(X_MapWindow, clientWin.frame);
+            XMapWindow(display_, clientWin.frame);
+        } else {
+            recordRequest(X_UnmapWindow, clientWin.frame);
+            XUnmapWindow(display_, clientWin.frame);
+        }
+    });
+    LOG(INFO) << "Switched to workspace " << workspace;
+}
+
+void WindowManager::moveToWorkspace(ClientWin &win, int workspace) {
+    forEachInGroup(win, [this, workspace](Handle, ClientWin &member) {
+        setWorkspace(member, workspace);
+    });
+}
+
+void WindowManager::setWorkspace(ClientWin &win, int workspace) {
+    win.workspace = workspace;
+    if (win.minimized)
+        return;
+    if (workspace == currentWorkspace_) {
+        recordRequest(X_MapWindow, win.frame);
+        XMapWindow(display_, win.frame);
+    } else {
+        recordRequest(X_UnmapWindow, win.frame);
+        XUnmapWindow(display_, win.frame);
+    }
+}
+
+string WindowManager::queryTree() {
+    std::ostringstream out;
+    out << "{\"workspace\":" << currentWorkspace_ << ",\"clients\":[";
+    bool first = true;
+    forEachClient([&](ClientWin &clientWin) {
+        Box outer;
+        if (!frames_.Get(clientWin.frame, &outer))
+            return;
+        out << (first ? "" : ",")
+            << "{\"window\":" << clientWin.w
+            << ",\"frame\":" << clientWin.frame
+            << ",\"title\":\"" << JsonEscape(titles_->Title(clientWin.w)) << "\""
+            << ",\"workspace\":" << clientWin.workspace
+            << ",\"responding\":" << (clientWin.ping.hung ? "false" : "true")
+            << ",\"maximized\":" << (clientWin.maximized ? "true" : "false")
+            << ",\"minimized\":" << (clientWin.minimized ? "true" : "false")
+            << ",\"x\":" << outer.x
+            << ",\"y\":" << outer.y
+            << ",\"width\":" << outer.width
+            << ",\"height\":" << outer.height << "}";
+        first = false;
+    });
+    out << "]}";
+    return out.str();
+}
+
+::std::vector<string> WindowManager::RunCommands(const ::std::vector<string> &commands) {
+    ::std::vector<string> replies;
+    replies.reserve(commands.size());
+    for (const string &command : commands) {
+        replies.push_back(RunCommand(command));
+    }
+    LOG(INFO) << "Ran batch of " << commands.size() << " IPC commands";
+    return replies;
+}
+
+string WindowManager::RunCommand(const string &command) {
+    std::istringstream in(command);
+    string name;
+    in >> name;
+
+    if (name == "query") {
+        return queryTree();
+    }
+    if (name == "restart") {
+        restarting_ = true;
+        return "ok";
+    }
+    if (name == "overview") {
+        if (overviewShown_)
+            hideOverview();
+        else
+            showOverview();
+        return compositor_ ? "ok" : "error: the overview needs compositing";
+    }
+    if (name == "workspace") {
+        int workspace;
+        if (!(in >> workspace) || workspace < 0)
+            return "error: usage: workspace <n>";
+        switchWorkspace(workspace);
+        return "ok";
+    }
+
+    string id;
+    in >> id;
+    ClientWin *win = id.empty() ? nullptr : clientFor(strtoul(id.c_str(), nullptr, 0));
+    if (name == "move" || name == "focus" || name == "raise" ||
+        name == "close" || name == "send" || name == "maximize" ||
+        name == "minimize" || name == "restore") {
+        if (win == nullptr)
+            return "error: no such window: " + id;
+    }
+
+    if (name == "move") {
+        int x, y;
+        if (!(in >> x >> y))
+            return "error: usage: move <window> <x> <y>";
+        ::std::vector<::std::pair<Handle, Box>> frames;
+        groupFrames(*win, &frames);
+        if (!frames.empty())
+            moveFrames(frames, x - frames[0].second.x, y - frames[0].second.y);
+        return "ok";
+    }
+    if (name == "focus") {
+        focusWindow(*win);
+        return "ok";
+    }
+    if (name == "raise") {
+        raiseGroup(*win);
+        return "ok";
+    }
+    if (name == "close") {
+        closeWindow(win->w);
+        return "ok";
+    }
+    if (name == "maximize") {
+        toggleMaximize(*win);
+        return "ok";
+    }
+    if (name == "minimize") {
+        minimize(*win);
+        return "ok";
+    }
+    if (name == "restore") {
+        unminimize(*win);
+        if (win->maximized)
+            toggleMaximize(*win);
+        return "ok";
+    }
+    if (name == "send") {
+        int workspace;
+        if (!(in >> workspace) || workspace < 0)
+            return "error: usage: send <window> <workspace>";
+        moveToWorkspace(*win, workspace);
+        return "ok";
     }
+    return "error: unknown command: " + name;
 }
-void WindowManager::OnKeyRelease(const XKeyEvent &e) {}
\ No newline at end of file
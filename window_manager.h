@@ -11,17 +11,35 @@ extern "C" {
 #include <vector>
 #include "util.h"
 #include "structs.h"
+#include "compositor.h"
+#include "config.h"
+#include "error_tracker.h"
+#include "file_watcher.h"
+#include "geometry_index.h"
+#include "ipc.h"
+#include "outputs.h"
+#include "pool.h"
+#include "rules.h"
+#include "session.h"
+#include "shape_cache.h"
+#include "timer_wheel.h"
+#include "title_renderer.h"
+#include "window_table.h"
 
 class WindowManager {
 public:
-    static ::std::unique_ptr<WindowManager> Create();
+    static ::std::unique_ptr<WindowManager> Create(const Config &config);
 
     ~WindowManager();
 
     void Run();
 
+    // Whether Run() returned because a restart was requested. The frames
+    // are then left for the new process to adopt.
+    bool restartRequested() const { return restarting_; }
+
 private:
-    WindowManager(Display *display);
+    WindowManager(Display *display, const Config &config);
 
     Display *display_;
     const Window root_;
@@ -30,12 +48,53 @@ private:
 
     void Unframe(Window w);
 
+    // Forgets a client and destroys its frame, without touching the client
+    // window itself.
+    void releaseClient(Handle handle);
+
+    // Handles a request of an operation on a client that failed, e.g. by
+    // rolling back the frame of a client that died while it was framed.
+    void onRequestFailed(const ErrorTracker::Failure &f);
+
+    // Installs the passive grabs on a framed client.
+    void grabClientInput(const ClientWin &client);
+
+    void grabClickToFocus(Window w);
+
+    void grabKey(const KeyBinding &key, Window w);
+
+    long frameEventMask() const;
+
+    // Returns the settings given on the command line overlaid with the
+    // config file.
+    ::std::shared_ptr<const Config> readConfig() const;
+
+    // Replaces the config snapshot after the config file changed and applies
+    // what differs from the previous snapshot.
+    void reloadConfig();
+
+    // Serializes the client table into _SIMPLEWM_STATE on the root window
+    // and keeps the frames alive after the connection closes.
+    void saveState();
+
+    // Takes over the frames of the previous instance from _SIMPLEWM_STATE.
+    void adoptState();
+
+    // Returns the client of a frame left behind by an instance that died
+    // without saving its state to the root window, or None if w is no frame.
+    Window releaseStaleFrame(Window w);
+
     static int OnXError(Display *display, XErrorEvent *e);
 
     static int OnWMDetected(Display *display, XErrorEvent *e);
 
     static bool wm_detected_;
     static ::std::mutex wm_detected_mutex_;
+    // Filled by OnXError, which Xlib calls without context.
+    static ErrorTracker errors_;
+
+    // Dispatches an X event to its handler.
+    void HandleEvent(XEvent &e);
 
     //Event Handlers
     void OnCreateNotify(const XCreateWindowEvent &e);
@@ -60,25 +119,266 @@ private:
 
     void OnMotionNotify(const XMotionEvent &e);
 
+    // Handles the XInput2 events of a drag grab.
+    void OnGenericEvent(XGenericEventCookie &cookie);
+
     void OnKeyPress(const XKeyEvent &e);
 
     void OnKeyRelease(const XKeyEvent &e);
 
+    void OnEnterNotify(const XCrossingEvent &e);
+
+    void OnPropertyNotify(const XPropertyEvent &e);
+
+    void OnExpose(const XExposeEvent &e);
+
+    void OnClientMessage(const XClientMessageEvent &e);
+
     void closeWindow(Window win);
 
-    void drawCross(ClientWin win);
+    bool supportsProtocol(Window w, Atom protocol);
+
+    // Sends _NET_WM_PING to a client unless a ping is already outstanding.
+    void sendPing(Handle client);
+
+    // Pings all clients and reschedules itself every Config::ping_interval_ms.
+    void pingAll();
+
+    void onPingTimeout(Handle client);
+
+    // Shows or clears the "not responding" state of a client's frame.
+    void setResponding(ClientWin &win, bool responding);
+
+    void drawCross(const ClientWin &win);
+
+    // Draws the close, maximize and minimize icons.
+    void drawIcons(const ClientWin &win);
+
+    void drawTitle(const ClientWin &win);
 
     void setBackground(const char *path);
 
+    void OnScreenChange();
+
+    // Schedules compositing of pending damage, at most once per
+    // Config::paint_interval_ms.
+    void schedulePaint();
+
+    // Executes a batch of IPC commands, returning one reply per command.
+    ::std::vector<::std::string> RunCommands(const ::std::vector<::std::string> &commands);
+
+    ::std::string RunCommand(const ::std::string &command);
+
+    // Notes a request about to be sent in the flight recorder.
+    void recordRequest(uint8_t opcode, Window w, unsigned long arg = 0);
+
+    // Returns the client owning a client, frame or decoration window.
+    ClientWin *clientFor(Window w);
+
+    // Calls f(win) for every managed client.
+    template <typename F>
+    void forEachClient(F f) {
+        clients_.ForEach([&f](Handle, ClientWin &win) { f(win); });
+    }
+
+    // Starts moving a client's frame with the pointer from a press on its
+    // title bar, through an XInput2 grab if Config::xinput_drag allows it.
+    void beginDrag(ClientWin &win, const XButtonEvent &e);
+
+    // Notes a pointer position of the drag in progress, sent by the server
+    // at time.
+    void dragMotion(double x, double y, Time time);
+
+    // Moves the dragged frame to the latest pointer position. Called once
+    // per batch of events, so a backlog of samples costs a single move.
+    void applyDrag();
+
+    void endDrag(Time time);
+
+    // Reads the cached WM_TRANSIENT_FOR and WM_HINTS window group of a client.
+    void fetchGroupHints(ClientWin &win);
+
+    // Returns the group a client belongs to: its window group if it has one,
+    // else the group of the managed client it is transient for, else itself.
+    Window groupKey(const ClientWin &win);
+
+    // Files a client and, recursively, its transients under their current
+    // group keys.
+    void regroup(ClientWin &win, int depth = 0);
+
+    void ungroup(ClientWin &win);
+
+    // Calls f(handle, member) for every member of a client's group, the
+    // client included.
+    template <typename F>
+    void forEachInGroup(const ClientWin &win, F f) {
+        const Handle *head = groups_.Find(win.group);
+        for (Handle handle = head != nullptr ? *head : Handle(); handle;) {
+            ClientWin &member = *clients_.Get(handle);
+            const Handle next = member.groupNext;
+            f(handle, member);
+            handle = next;
+        }
+    }
+
+    // Whether win is transient for ancestor, directly or through other
+    // transients.
+    bool isTransientOf(const ClientWin &win, Window ancestor);
+
+    // Appends the frames that move along with win, win first: the members
+    // of its group shown on its workspace that are neither minimized nor
+    // maximized.
+    void groupFrames(const ClientWin &win, ::std::vector<::std::pair<Handle, Box>> *out);
+
+    // Moves each frame to its box translated by (dx, dy).
+    void moveFrames(const ::std::vector<::std::pair<Handle, Box>> &frames, int dx, int dy);
+
+    // Raises the group of a client with a single restack: the client above
+    // the rest of its group and its transients above the client.
+    void raiseGroup(const ClientWin &win);
+
+    // Unminimizes, raises and focuses a client.
+    void focusWindow(ClientWin &win);
+
+    // Gives a client the input focus and moves the click-to-focus grab from
+    // it to the previously focused client.
+    void setFocus(ClientWin &win);
+
+    // Focuses the next client on the current workspace.
+    void cycleFocus();
+
+    // Shows the clients of the current workspace as thumbnails in a grid
+    // and grabs the pointer and keyboard to pick one, or lays the grid out
+    // again if it is shown.
+    void showOverview();
+
+    void hideOverview();
+
+    // Focuses the client whose thumbnail is at (x, y) and hides the overview.
+    void pickFromOverview(int x, int y);
+
+    // Height of a client's title bar, 0 if it is undecorated.
+    int titleHeight(const ClientWin &win) const;
+
+    // Vertical position of the icons in the title bar.
+    int iconOffset() const;
+
+    // Sets the ICCCM WM_STATE of a client.
+    void setWMState(Window w, long state);
+
+    // Resizes the title bar to width and moves its icons along.
+    void layoutTitleBar(ClientWin &win, unsigned int width);
+
+    // Moves and resizes a frame, its client and its title bar to outer.
+    void setFrameGeometry(ClientWin &win, const Box &outer);
+
+    // Maximizes a client to the work area of its output, or restores the
+    // geometry it had before.
+    void toggleMaximize(ClientWin &win);
+
+    // Minimizes or unminimizes a client and the rest of its group.
+    void minimize(ClientWin &win);
+
+    void unminimize(ClientWin &win);
+
+    void setMinimized(ClientWin &win, bool minimized);
+
+    void switchWorkspace(int workspace);
+
+    // Moves a client and the rest of its group to a workspace.
+    void moveToWorkspace(ClientWin &win, int workspace);
+
+    void setWorkspace(ClientWin &win, int workspace);
+
+    ::std::string queryTree();
+
+    bool hasRequestedPosition(Window w);
+
+    // Fetches the instance and class names of a client's WM_CLASS.
+    void fetchClass(Window w, ::std::string *instance, ::std::string *wm_class);
+
+    // Returns the session key of a client from WM_CLASS and WM_WINDOW_ROLE,
+    // or 0 if it has no WM_CLASS.
+    uint64_t sessionKey(Window w, const ::std::string &instance, const ::std::string &wm_class);
+
+    // Applies the geometry of a rule to the outer frame rectangle of a new
+    // client.
+    void applyRuleGeometry(const WindowRule &rule, int title_height, Box *outer);
+
+    // Returns the remembered outer geometry for a new client with the given
+    // session key, if it is still usable.
+    bool restoreGeometry(uint64_t key, Box *outer);
+
     BackgroundImage bg;
+    // Settings from the command line, which the config file overrides.
+    const Config baseConfig_;
+    ::std::shared_ptr<const Config> config_;
+    ::std::unique_ptr<TitleRenderer> titles_;
+    ::std::unique_ptr<Compositor> compositor_;
+    ::std::unique_ptr<SessionStore> session_;
+    WindowRules rules_;
 
-    ::std::unordered_map<Window, Window> clients_;
-    ::std::vector<ClientWin> clientWindows;
-    Position<int> startPos;
-    Position<int> startFramePos;
-    Position<int> startFrameSize;
+    // Client records, and the client, frame and decoration windows of each
+    // client mapped to its record.
+    Pool<ClientWin> clients_;
+    WindowTable windows_;
+    // The first member of every group; the others are linked through
+    // ClientWin::groupNext.
+    WindowMap<Handle> groups_;
+    GeometryIndex frames_;
+    OutputLayout outputs_;
+    ShapeCache shapes_;
+    Position<int> lastPointer_;
+    IpcServer ipc_;
+    FileWatcher watcher_;
+    TimerWheel timers_;
+    TimerId paintTimer_;
+    TimerId pingTimer_;
+    uint64_t lastPaint_;
+    long pingSerial_;
+    bool restarting_;
+    Handle focused_;
+    // Pending focus-follows-mouse change.
+    TimerId focusTimer_;
+    int currentWorkspace_;
+    // A title bar drag, active while client resolves.
+    struct Drag {
+        Handle client;
+        // Whether the pointer is tracked through an XInput2 grab, with
+        // sub-pixel precision, rather than through core motion events.
+        bool xinput;
+        int pointer;
+        double start_x, start_y;
+        Box start_frame;
+        // The frames moving along, the dragged one first, where they were
+        // when the drag started.
+        ::std::vector<::std::pair<Handle, Box>> frames;
+        ::std::vector<Window> moved;
+        bool pending;
+        double x, y;
+        // Server time of the oldest sample not applied yet.
+        Time time;
+        // Motion-to-move latency. The server clock is related to ours by
+        // the smallest difference between receiving and sending a sample.
+        int64_t clock_offset;
+        uint32_t samples, moves;
+        uint64_t latency_total, latency_max;
+    };
+    Drag drag_;
+    // Major opcode of XInputExtension, or -1 without XInput 2.
+    int xiOpcode_;
+    bool overviewShown_;
+    // Clients in the overview and the rectangles of their thumbnails.
+    ::std::vector<::std::pair<Handle, Box>> overview_;
     const Atom WM_PROTOCOLS;
     const Atom WM_DELETE_WINDOW;
+    const Atom NET_WM_NAME;
+    const Atom NET_WM_PING;
+    const Atom SIMPLEWM_STATE;
+    const Atom SIMPLEWM_FRAME;
+    const Atom WM_WINDOW_ROLE;
+    const Atom WM_STATE;
+    const Atom WM_CHANGE_STATE;
 };
 
 #endif
\ No newline at end of file
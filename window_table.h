@@ -0,0 +1,142 @@
+#ifndef SIMPLEWM_WINDOW_TABLE_H
+#define SIMPLEWM_WINDOW_TABLE_H
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <vector>
+#include "pool.h"
+
+// Flat hash table from X window IDs to values.
+//
+// Open addressing with linear probing in a power-of-two array; erasing
+// shifts the following entries back instead of leaving tombstones, so the
+// table never needs a rehash to clean up and only allocates when it grows.
+// None is not a valid key.
+template <typename V>
+class WindowMap {
+public:
+    WindowMap()
+        : entries_(INITIAL_CAPACITY, Entry{None, V()}),
+          mask_(INITIAL_CAPACITY - 1),
+          size_(0) {
+    }
+
+    // Maps w to v, replacing any previous mapping.
+    void Insert(Window w, const V &v) {
+        // Keep the load factor at or below 1/2 so that probe runs stay short.
+        if (2 * (size_ + 1) > entries_.size())
+            Grow();
+        for (size_t i = Home(w);; i = (i + 1) & mask_) {
+            Entry &e = entries_[i];
+            if (e.key == None) {
+                e.key = w;
+                e.value = v;
+                ++size_;
+                return;
+            }
+            if (e.key == w) {
+                e.value = v;
+                return;
+            }
+        }
+    }
+
+    // Returns the value w maps to, or nullptr.
+    V *Find(Window w) {
+        if (w == None)
+            return nullptr;
+        for (size_t i = Home(w);; i = (i + 1) & mask_) {
+            Entry &e = entries_[i];
+            if (e.key == w)
+                return &e.value;
+            if (e.key == None)
+                return nullptr;
+        }
+    }
+
+    const V *Find(Window w) const {
+        return const_cast<WindowMap *>(this)->Find(w);
+    }
+
+    // Removes the mapping of w. Returns false if there was none.
+    bool Erase(Window w) {
+        if (w == None)
+            return false;
+        size_t hole = Home(w);
+        while (entries_[hole].key != w) {
+            if (entries_[hole].key == None)
+                return false;
+            hole = (hole + 1) & mask_;
+        }
+        // Move back every entry of the run after the hole that may live
+        // there, i.e. whose home is not cyclically within (hole, i].
+        for (size_t i = (hole + 1) & mask_; entries_[i].key != None; i = (i + 1) & mask_) {
+            const size_t home = Home(entries_[i].key);
+            if (((i - home) & mask_) >= ((i - hole) & mask_)) {
+                entries_[hole] = entries_[i];
+                hole = i;
+            }
+        }
+        entries_[hole].key = None;
+        entries_[hole].value = V();
+        --size_;
+        return true;
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    static const size_t INITIAL_CAPACITY = 64;
+
+    struct Entry {
+        Window key;
+        V value;
+    };
+
+    size_t Home(Window w) const {
+        // Window IDs of one client are consecutive; Fibonacci hashing
+        // spreads them over the whole table.
+        return (static_cast<uint64_t>(w) * 0x9E3779B97F4A7C15ull) >> 32 & mask_;
+    }
+
+    void Grow() {
+        ::std::vector<Entry> old(2 * entries_.size(), Entry{None, V()});
+        old.swap(entries_);
+        mask_ = entries_.size() - 1;
+        size_ = 0;
+        for (const Entry &e : old) {
+            if (e.key != None)
+                Insert(e.key, e.value);
+        }
+    }
+
+    ::std::vector<Entry> entries_;
+    size_t mask_;
+    size_t size_;
+};
+
+// Maps the client, frame and decoration windows of clients to the pool
+// handles of their records.
+class WindowTable {
+public:
+    // Maps w to h, replacing any previous mapping.
+    void Insert(Window w, Handle h) { map_.Insert(w, h); }
+
+    // Returns the handle w maps to, or the null handle.
+    Handle Find(Window w) const {
+        const Handle *h = map_.Find(w);
+        return h != nullptr ? *h : Handle();
+    }
+
+    // Removes the mapping of w. Returns false if there was none.
+    bool Erase(Window w) { return map_.Erase(w); }
+
+    size_t size() const { return map_.size(); }
+
+private:
+    WindowMap<Handle> map_;
+};
+
+#endif
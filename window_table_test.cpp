@@ -0,0 +1,120 @@
+#include "window_table.h"
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <glog/logging.h>
+
+using ::std::vector;
+
+namespace {
+
+// Random inserts, erases and lookups against unordered_map. Keys come from
+// a small range, as window IDs of one client do, so that probe runs are
+// long and erasing has to shift entries back across them and across the
+// end of the array.
+void TestWindowMap() {
+    ::std::mt19937 rng(1);
+    WindowMap<uint32_t> map;
+    ::std::unordered_map<Window, uint32_t> expected;
+    for (int step = 0; step < 200000; ++step) {
+        const Window w = rng() % 3000 + 1;
+        switch (rng() % 3) {
+            case 0:
+                map.Insert(w, step);
+                expected[w] = step;
+                break;
+            case 1:
+                CHECK_EQ(map.Erase(w), expected.erase(w) == 1);
+                break;
+            default: {
+                const uint32_t *v = map.Find(w);
+                auto it = expected.find(w);
+                CHECK_EQ(v != nullptr, it != expected.end());
+                if (v != nullptr) {
+                    CHECK_EQ(*v, it->second);
+                }
+            }
+        }
+        CHECK_EQ(map.size(), expected.size());
+        // Every erase must leave all other keys reachable.
+        if (step % 1000 == 0) {
+            for (const auto &e : expected) {
+                const uint32_t *v = map.Find(e.first);
+                CHECK(v != nullptr && *v == e.second) << "Lost window " << e.first;
+            }
+        }
+    }
+    CHECK(map.Find(None) == nullptr);
+    CHECK(!map.Erase(None));
+}
+
+void TestWindowTable() {
+    Pool<int> pool;
+    WindowTable table;
+    const Handle h = pool.Allocate();
+    CHECK(!table.Find(7));
+    table.Insert(7, h);
+    table.Insert(8, h);
+    CHECK(table.Find(7) == h);
+    CHECK(table.Erase(7));
+    CHECK(!table.Erase(7));
+    CHECK(!table.Find(7));
+    CHECK(table.Find(8) == h);
+    CHECK_EQ(table.size(), 1u);
+}
+
+struct Record {
+    int value;
+    vector<int> data;
+};
+
+void TestPool() {
+    Pool<Record> pool;
+    CHECK(pool.Get(Handle()) == nullptr);
+
+    // Records never move, even when new chunks are added.
+    vector<Handle> handles;
+    vector<Record *> records;
+    for (uint32_t i = 0; i < 3 * Pool<Record>::CHUNK_SIZE; ++i) {
+        handles.push_back(pool.Allocate());
+        records.push_back(pool.Get(handles.back()));
+        records.back()->value = i;
+    }
+    for (size_t i = 0; i < handles.size(); ++i) {
+        CHECK_EQ(pool.Get(handles[i]), records[i]);
+        CHECK_EQ(records[i]->value, static_cast<int>(i));
+    }
+
+    // A freed slot is reused, value-initialized, under a new generation.
+    pool.Get(handles[5])->data.push_back(1);
+    pool.Free(handles[5]);
+    CHECK(pool.Get(handles[5]) == nullptr);
+    pool.Free(handles[5]);
+    CHECK_EQ(pool.size(), handles.size() - 1);
+    const Handle reused = pool.Allocate();
+    CHECK_EQ(reused.index, handles[5].index);
+    CHECK(reused != handles[5]);
+    CHECK(pool.Get(handles[5]) == nullptr);
+    CHECK_EQ(pool.Get(reused), records[5]);
+    CHECK_EQ(records[5]->value, 0);
+    CHECK(records[5]->data.empty());
+    handles[5] = reused;
+
+    size_t live = 0;
+    pool.ForEach([&](Handle h, Record &r) {
+        CHECK_EQ(&r, pool.Get(h));
+        ++live;
+    });
+    CHECK_EQ(live, pool.size());
+}
+
+}
+
+int main() {
+    TestWindowMap();
+    TestWindowTable();
+    TestPool();
+    printf("window_table_test passed\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "worker_pool.h"
+
+using ::std::function;
+using ::std::lock_guard;
+using ::std::mutex;
+using ::std::unique_lock;
+
+WorkerPool::WorkerPool(unsigned int threads)
+    : job_(nullptr),
+      count_(0),
+      generation_(0),
+      next_(0),
+      busy_(0),
+      stopping_(false) {
+    if (threads == 0) {
+        const unsigned int cpus = ::std::thread::hardware_concurrency();
+        threads = cpus > 1 ? cpus - 1 : 0;
+    }
+    for (unsigned int i = 0; i < threads; ++i) {
+        threads_.emplace_back([this]() { Work(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (::std::thread &t : threads_) {
+        t.join();
+    }
+}
+
+void WorkerPool::ParallelFor(size_t n, const function<void(size_t)> &f) {
+    if (threads_.empty() || n <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            f(i);
+        }
+        return;
+    }
+    {
+        lock_guard<mutex> lock(mutex_);
+        job_ = &f;
+        count_ = n;
+        next_ = 0;
+        busy_ = threads_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+    RunIterations(f, n);
+    unique_lock<mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return busy_ == 0; });
+    job_ = nullptr;
+}
+
+void WorkerPool::Work() {
+    uint64_t generation = 0;
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        start_.wait(lock, [this, generation]() {
+            return stopping_ || generation_ != generation;
+        });
+        if (stopping_) {
+            return;
+        }
+        generation = generation_;
+        const function<void(size_t)> *job = job_;
+        const size_t n = count_;
+        lock.unlock();
+        RunIterations(*job, n);
+        lock.lock();
+        if (--busy_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void WorkerPool::RunIterations(const function<void(size_t)> &f, size_t n) {
+    for (size_t i = next_++; i < n; i = next_++) {
+        f(i);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SIMPLEWM_WORKER_POOL_H
+#define SIMPLEWM_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads running the iterations of a loop in parallel.
+//
+// Iterations are handed out one at a time from a shared counter, so that
+// uneven ones, like thumbnails of different sizes, balance themselves. The
+// calling thread takes part as well. The workers never touch the X
+// connection; they only process memory handed to them.
+class WorkerPool {
+public:
+    // Starts threads workers, or one less than the number of CPUs for 0.
+    explicit WorkerPool(unsigned int threads = 0);
+
+    ~WorkerPool();
+
+    // Calls f(i) for every i in [0, n) and returns when all calls are done.
+    void ParallelFor(size_t n, const ::std::function<void(size_t)> &f);
+
+    size_t size() const { return threads_.size(); }
+
+private:
+    void Work();
+
+    void RunIterations(const ::std::function<void(size_t)> &f, size_t n);
+
+    ::std::vector<::std::thread> threads_;
+    ::std::mutex mutex_;
+    ::std::condition_variable start_;
+    ::std::condition_variable done_;
+    // The loop being run, announced by a new generation.
+    const ::std::function<void(size_t)> *job_;
+    size_t count_;
+    uint64_t generation_;
+    ::std::atomic<size_t> next_;
+    // Workers that have not finished the current loop yet.
+    size_t busy_;
+    bool stopping_;
+};
+
+#endif